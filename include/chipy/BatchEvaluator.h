@@ -0,0 +1,41 @@
+#pragma once
+
+#include "chipy/Interpreter.h"
+
+namespace chipy
+{
+
+// Runs one program over many input documents
+// A single interpreter and arena are reused; everything a record allocates
+// is released before the next one
+class BatchEvaluator
+{
+public:
+    // Each document is bound to input_name in turn
+    BatchEvaluator(const BitStream &program, const std::string &input_name);
+    BatchEvaluator(const std::shared_ptr<const BitStream> &program, const std::string &input_name);
+
+    // Throws if the program leaves values of the record alive, e.g. in a module
+    bool evaluate(const json::Document &doc);
+
+    // One bit per document
+    std::vector<bool> evaluate(const json::Document *docs, size_t count);
+    std::vector<bool> evaluate(const std::vector<json::Document> &docs);
+
+    // Modules set here are kept across records, other global values are not
+    Interpreter& interpreter()
+    {
+        return m_interpreter;
+    }
+
+private:
+    Interpreter m_interpreter;
+    const std::string m_input_name;
+
+    // Only the parts of each document the program reads are converted
+    InputSet m_inputs;
+
+    RecordMark m_record;
+};
+
+}
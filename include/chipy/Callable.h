@@ -15,10 +15,27 @@ protected:
 public:
     virtual ValuePtr call(const std::vector<ValuePtr>& args) = 0;
 
+    // Called by the interpreter with arguments that live on its stack
+    // Callables that can avoid the vector override this
+    virtual ValuePtr invoke(const ValuePtr *args, uint32_t num_args)
+    {
+        return call(std::vector<ValuePtr>(args, args + num_args));
+    }
+
     bool is_callable() const override
     {
         return true;
     }
+
+    // Pure callables return equal results for equal arguments, so the
+    // interpreter reuses their results within an execution
+    virtual bool is_pure() const
+    {
+        return false;
+    }
+
+    // Called instead of invoke() when a result was reused
+    virtual void count_reused_result() {}
 };
 
 }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+
+#include "chipy/Interpreter.h"
+
+namespace chipy
+{
+
+enum class ColumnType
+{
+    Integer,
+    Float,
+    String
+};
+
+// One input field for every row of a batch
+// Strings are dictionary encoded: row i holds dictionary[codes[i]]
+struct Column
+{
+    ColumnType type;
+
+    std::vector<int32_t> integers;
+    std::vector<double> floats;
+
+    std::vector<std::string> dictionary;
+    std::vector<uint32_t> codes;
+};
+
+// Records stored column by column
+// A column's path names the value it provides, e.g. {"request", "user"} is
+// request['user']; columns have no missing values
+class ColumnBatch
+{
+public:
+    ColumnBatch(size_t num_rows);
+
+    void add_int_column(const InputPath &path, const std::vector<int32_t> &values);
+    void add_float_column(const InputPath &path, const std::vector<double> &values);
+    void add_string_column(const InputPath &path, const std::vector<std::string> &dictionary, const std::vector<uint32_t> &codes);
+
+    size_t num_rows() const
+    {
+        return m_num_rows;
+    }
+
+    // nullptr if there is no column for path
+    const Column* find(const InputPath &path) const;
+
+    const std::map<InputPath, Column>& columns() const
+    {
+        return m_columns;
+    }
+
+private:
+    Column& add_column(const InputPath &path, ColumnType type, size_t size);
+
+    size_t m_num_rows;
+    std::map<InputPath, Column> m_columns;
+};
+
+// Evaluates a filter over a whole batch at once
+//
+// Programs of the form `return <expr>` are planned into compare kernels over
+// columns that pass selection vectors (sorted row indices) to each other.
+// Compares of a column with constants, `in` tests against constant
+// collections, `and`, `or` and `not` are supported. Rows that the kernels
+// cannot decide are run through the interpreter one by one.
+class ColumnarEvaluator
+{
+public:
+    ColumnarEvaluator(const BitStream &program);
+
+    // One bit per row
+    std::vector<bool> evaluate(const ColumnBatch &batch);
+
+    // Indices of the rows for which the program returns True
+    std::vector<uint32_t> select(const ColumnBatch &batch);
+
+    // Can batch be decided without the interpreter?
+    bool is_vectorized(const ColumnBatch &batch) const;
+
+    // Number of rows that were run by the interpreter so far
+    size_t num_scalar_rows() const
+    {
+        return m_num_scalar_rows;
+    }
+
+private:
+    bool evaluate_row(const ColumnBatch &batch, uint32_t row);
+
+    // The returned expression, if the program is a single return
+    std::shared_ptr<const Node> m_expression;
+
+    Interpreter m_interpreter;
+    InputSet m_inputs;
+
+    RecordMark m_record;
+
+    size_t m_num_scalar_rows = 0;
+};
+
+}
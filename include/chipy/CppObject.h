@@ -0,0 +1,156 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "chipy/NativeFunction.h"
+
+namespace chipy
+{
+
+// Table of the fields and methods of a host type that scripts may access
+// Entries are generated at compile time by CHIPY_FIELD and CHIPY_METHOD
+class CppClass
+{
+public:
+    typedef ValuePtr (*getter_t)(MemoryManager &mem, void *object);
+
+    CppClass& add(const std::string &name, getter_t getter)
+    {
+        m_members[name] = getter;
+        return *this;
+    }
+
+    getter_t find(const std::string &name) const
+    {
+        auto it = m_members.find(name);
+        if(it == m_members.end())
+            return nullptr;
+
+        return it->second;
+    }
+
+private:
+    std::unordered_map<std::string, getter_t> m_members;
+};
+
+// A host object exposed to scripts
+// Fields are read in place on every access; the object and its class must
+// outlive the value
+class CppObject : public Value
+{
+public:
+    CppObject(MemoryManager &mem, const CppClass &cls, void *object)
+        : Value(mem), m_class(cls), m_object(object)
+    {}
+
+    ValueType type() const override
+    {
+        return ValueType::CppObject;
+    }
+
+    ValuePtr duplicate() override
+    {
+        return wrap_value(new (memory_manager()) CppObject(memory_manager(), m_class, m_object));
+    }
+
+    ValuePtr get_member(const std::string &name)
+    {
+        auto getter = m_class.find(name);
+        if(!getter)
+            throw std::runtime_error("No such member: " + name);
+
+        return getter(memory_manager(), m_object);
+    }
+
+private:
+    const CppClass &m_class;
+    void *m_object;
+};
+
+template<typename T>
+ValuePtr make_cpp_object(MemoryManager &mem, const CppClass &cls, T *object)
+{
+    return wrap_value(new (mem) CppObject(mem, cls, object));
+}
+
+// Boxes a field; strings and string lists refer to the field instead of copying it
+template<typename F>
+struct CppField
+{
+    static ValuePtr make(MemoryManager &mem, const F &field)
+    {
+        return NativeResult<F>::make(mem, field);
+    }
+};
+
+template<>
+struct CppField<std::string>
+{
+    static ValuePtr make(MemoryManager &mem, const std::string &field)
+    {
+        return mem.create_string(&field);
+    }
+};
+
+template<>
+struct CppField<std::vector<std::string>>
+{
+    static ValuePtr make(MemoryManager &mem, const std::vector<std::string> &field)
+    {
+        return mem.create_string_list(&field);
+    }
+};
+
+template<typename T, typename F, F T::*Field>
+ValuePtr get_cpp_field(MemoryManager &mem, void *object)
+{
+    return CppField<F>::make(mem, static_cast<T*>(object)->*Field);
+}
+
+template<typename T, typename M, typename R, typename... Args>
+struct CppBoundMethod
+{
+    T *object;
+    M method;
+
+    R operator()(Args... args) const
+    {
+        return (object->*method)(args...);
+    }
+};
+
+template<typename M>
+struct CppMethodTraits;
+
+template<typename T, typename R, typename... Args>
+struct CppMethodTraits<R (T::*)(Args...)>
+{
+    typedef CppBoundMethod<T, R (T::*)(Args...), R, Args...> bound_t;
+    typedef NativeFunction<bound_t, R, Args...> function_t;
+};
+
+template<typename T, typename R, typename... Args>
+struct CppMethodTraits<R (T::*)(Args...) const>
+{
+    typedef CppBoundMethod<T, R (T::*)(Args...) const, R, Args...> bound_t;
+    typedef NativeFunction<bound_t, R, Args...> function_t;
+};
+
+template<typename T, typename M, M Method>
+ValuePtr get_cpp_method(MemoryManager &mem, void *object)
+{
+    typedef typename CppMethodTraits<M>::bound_t bound_t;
+    typedef typename CppMethodTraits<M>::function_t function_t;
+
+    bound_t bound = { static_cast<T*>(object), Method };
+    return wrap_value(new (mem) function_t(mem, bound));
+}
+
+}
+
+// Usage: CppClass().add(CHIPY_FIELD(Request, path)).add(CHIPY_METHOD(Request, header))
+#define CHIPY_FIELD(type, field) \
+    #field, &chipy::get_cpp_field<type, decltype(type::field), &type::field>
+
+#define CHIPY_METHOD(type, method) \
+    #method, &chipy::get_cpp_method<type, decltype(&type::method), &type::method>
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <mutex>
+
+#include "chipy/Interpreter.h"
+
+namespace chipy
+{
+
+// Remembers the results of a program by the input values it actually read
+//
+// A run records the paths of the global values it reads, e.g.
+// request['user']. Any later input with the same values at those paths
+// makes the program take the same steps, so the result is reused.
+//
+// Programs that use modules which are not deterministic, e.g. rand, or that
+// print are marked uncacheable after their first run. Host functions are
+// assumed to be deterministic.
+//
+// A cache belongs to one program, but the interpreters of multiple threads
+// can share it
+class DecisionCache
+{
+public:
+    DecisionCache(size_t max_entries = 100000, size_t num_shards = 16);
+
+    DecisionCache(const DecisionCache &other) = delete;
+
+    // Runs interpreter.execute(), unless an earlier run read the same values
+    bool execute(Interpreter &interpreter);
+
+    uint64_t hits() const
+    {
+        return m_hits;
+    }
+
+    uint64_t misses() const
+    {
+        return m_misses;
+    }
+
+    size_t size() const;
+
+    bool is_cacheable() const
+    {
+        return m_cacheable;
+    }
+
+    void clear();
+
+private:
+    static constexpr size_t MAX_SHAPES = 64;
+
+    struct Entry
+    {
+        bool result;
+        std::list<const std::string*>::iterator position;
+    };
+
+    // Least recently used entries are at the back
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        std::list<const std::string*> order;
+    };
+
+    bool lookup(Interpreter &interpreter, bool &result);
+    void store(Interpreter &interpreter, bool result);
+
+    Shard& shard(const std::string &key);
+
+    const size_t m_shard_capacity;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    // The sets of paths that runs have read
+    // Only ever appended to, so readers just need the count
+    std::vector<std::vector<InputPath>> m_shapes;
+    std::atomic<size_t> m_num_shapes;
+    std::mutex m_shapes_mutex;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<bool> m_cacheable;
+};
+
+}
@@ -15,7 +15,7 @@ class DictItemIterator : public Generator
 public:
     DictItemIterator(MemoryManager &mem, Dictionary &dict);
 
-    ValuePtr next() override;
+    bool next(ValuePtr &out) override;
 
     ValuePtr duplicate() override;
 
@@ -61,7 +61,7 @@ class DictKeyIterator : public Generator
 public:
     DictKeyIterator(MemoryManager &mem, Dictionary &dict);
 
-    ValuePtr next() override;
+    bool next(ValuePtr &out) override;
 
     ValuePtr duplicate() override;
 
@@ -81,11 +81,15 @@ public:
 
     ValuePtr get(const std::string &key);
 
+    // Shared string value for the key of an entry, only created on first use
+    StringValPtr key_value(const std::pair<const std::string, ValuePtr> &entry);
+
     DictItemsPtr items();
 
     uint32_t size() const;
 
     void insert(const std::string &key, ValuePtr value);
+    void insert(std::string &&key, ValuePtr value);
 
     ValueType type() const override;
 
@@ -95,8 +99,17 @@ public:
 
     const std::map<std::string, ValuePtr>& elements() const;
 
-private:
+protected:
+    // Hooks for dictionaries that only materialize their entries on demand
+    // load() is called for keys that are not present yet
+    virtual ValuePtr load(const std::string &key);
+    virtual void load_all();
+
     std::map<std::string, ValuePtr> m_elements;
+
+private:
+    // Map keys have stable addresses, so they can identify their key values
+    std::unordered_map<const std::string*, StringValPtr> m_key_values;
 };
 
 }
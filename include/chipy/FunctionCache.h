@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "chipy/Callable.h"
+
+namespace chipy
+{
+
+// Memoizes host functions whose results only depend on their arguments,
+// e.g. expensive lookups such as group membership
+//
+// Functions are wrapped with make_pure(). Within one execution the
+// interpreter reuses results directly; across executions, and across the
+// interpreters of multiple threads, results are kept in this cache.
+// Only arguments and results made of plain values are cached
+// Not available in the enclave build
+class FunctionCache
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    FunctionCache(size_t max_entries = 10000);
+
+    FunctionCache(const FunctionCache &other) = delete;
+
+    // Wraps function so that its results are memoized under name
+    // Results expire after ttl; zero keeps them until they are evicted
+    // Interpreters that wrap the same function must use the same name and ttl
+    ValuePtr make_pure(MemoryManager &mem, const std::string &name, const ValuePtr &function,
+                       clock::duration ttl = clock::duration::zero());
+
+    struct Stats
+    {
+        uint64_t calls = 0;
+
+        // Calls answered within the execution and from this cache
+        uint64_t execution_hits = 0;
+        uint64_t shared_hits = 0;
+
+        double hit_rate() const
+        {
+            return calls ? static_cast<double>(execution_hits + shared_hits) / calls : 0.0;
+        }
+    };
+
+    Stats stats(const std::string &name) const;
+
+    size_t size() const;
+
+    void clear();
+
+private:
+    friend class PureFunction;
+
+    struct Function
+    {
+        uint32_t id;
+        std::string name;
+        clock::duration ttl;
+
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> execution_hits;
+        std::atomic<uint64_t> shared_hits;
+    };
+
+    struct StoredValue;
+
+    struct Entry
+    {
+        std::shared_ptr<const StoredValue> result;
+        clock::time_point expires;
+        std::list<const std::string*>::iterator position;
+    };
+
+    static bool store_value(const ValuePtr &value, StoredValue &stored);
+    static ValuePtr load_value(MemoryManager &mem, const StoredValue &stored);
+
+    ValuePtr invoke(Function &function, Callable &callable, MemoryManager &mem, const ValuePtr *args, uint32_t num_args);
+
+    bool lookup(const std::string &key, std::shared_ptr<const StoredValue> &result);
+    void store(const std::string &key, const Function &function, const std::shared_ptr<const StoredValue> &result);
+
+    const size_t m_max_entries;
+
+    mutable std::mutex m_mutex;
+
+    std::vector<std::unique_ptr<Function>> m_functions;
+    std::unordered_map<std::string, Function*> m_function_names;
+
+    // Least recently used entries are at the back
+    std::unordered_map<std::string, Entry> m_entries;
+    std::list<const std::string*> m_order;
+};
+
+}
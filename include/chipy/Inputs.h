@@ -0,0 +1,45 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "chipy/Object.h"
+#include "json/json.h"
+
+namespace chipy
+{
+
+// A global name followed by the constant keys it is subscripted with,
+// e.g. request['headers']['x-user'] is {"request", "headers", "x-user"}
+typedef std::vector<std::string> InputPath;
+
+// The parts of the global inputs that a program may read
+// A path covers everything below it
+class InputSet
+{
+public:
+    void add(const InputPath &path);
+
+    const std::set<InputPath>& paths() const
+    {
+        return m_paths;
+    }
+
+    std::set<std::string> names() const;
+
+    // Is path or anything below it read?
+    bool reads(const InputPath &path) const;
+
+    // Converts only the parts of doc that are read through name
+    ValuePtr project(MemoryManager &mem, const std::string &name, const json::Document &doc) const;
+
+private:
+    std::set<InputPath> m_paths;
+};
+
+// Finds all names that can be read before the program assigns them, and the
+// constant subscripts applied to them
+InputSet analyze_inputs(const BitStream &data);
+
+}
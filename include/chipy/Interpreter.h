@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <set>
 #include <string>
 
 #include "chipy/NodeType.h"
@@ -8,50 +10,220 @@
 #include "Value.h"
 #include "Tuple.h"
 #include "Scope.h"
+#include "Inputs.h"
 
 namespace chipy
 {
 
+struct Node;
+
+enum class BinaryOpType;
+enum class CompareOpType;
+
 class Interpreter
 {
 public:
     Interpreter(const BitStream &data);
+
+    // Shares the program with other interpreters instead of copying it
+    Interpreter(const std::shared_ptr<const BitStream> &program);
     ~Interpreter();
 
     bool execute();
 
+    // Does the work that would otherwise happen during the first execution,
+    // e.g. loading imported modules and building constant tables
+    void prepare();
+
+    // Forgets all global values, so the program can run again on new inputs
+    // Modules and prepared state are kept
+    void reset();
+
     void set_module(const std::string& name, ModulePtr module);
 
+    // Binds any value, e.g. one created by make_cpp_object
+    void set_value(const std::string& name, ValuePtr value);
+
     void set_list(const std::string& name, const std::vector<std::string> &list);
     void set_string(const std::string& name, const std::string &value);
+
+    // Bind host-owned strings without copying them
+    // Pointers must stay valid until the interpreter is done; shared pointers
+    // are kept alive by the values that use them
+    void set_list(const std::string& name, const std::vector<std::string> *list);
+    void set_list(const std::string& name, const std::shared_ptr<const std::vector<std::string>> &list);
+    void set_string(const std::string& name, const std::string *value);
+    void set_string(const std::string& name, const std::shared_ptr<const std::string> &value);
+
+    void set_set(const std::string& name, const std::vector<std::string> &elements);
+
+    // Values are converted on access, so doc must outlive the interpreter's use of them
+    void set_document(const std::string& name, const json::Document &doc);
+
+    // Parses JSON text directly into values
+    void set_json(const std::string& name, const std::string &text);
+
+    // Only converts the parts of doc listed in inputs
+    void set_document(const std::string& name, const json::Document &doc, const InputSet &inputs);
     
     void set_module(const std::string& name, ModulePtr &module);
 
+    // Lets interpreters that run identical pure expressions evaluate them once
+    // slots maps the position of an expression in the program to its index in
+    // values; values must be cleared before the interpreter is reset
+    void set_shared_values(const std::map<uint32_t, uint32_t> &slots, std::vector<ValuePtr> *values);
+
     MemoryManager& memory_manager()
     {
         return m_mem;
     }
 
+    // Records which parts of the global values executions read, see DecisionCache
+    void set_read_tracking(bool enabled);
+
+    struct Read
+    {
+        // A global name followed by subscripts, encoded as 's' + key for
+        // dictionaries and 'i' + index for lists and tuples
+        InputPath path;
+
+        ValuePtr value;
+    };
+
+    // What the last execution read, without the values that were only
+    // subscripted further
+    std::vector<Read> reads() const;
+
+    // False if the last execution also depended on something else, e.g. rand
+    bool reads_complete() const
+    {
+        return m_reads_complete;
+    }
+
+    // Looks up a path of reads() in the current global values
+    // Returns false if the program could not have read it without an error
+    bool resolve(const InputPath &path, ValuePtr &value);
+
 private:
     enum class LoopState { None, TopLevel, Normal, Break, Continue };
 
     ModulePtr get_module(const std::string &name);
 
+    void prepare(const Node &node);
+
     ValuePtr execute_next(Scope &scope, LoopState &loop_state);
     void skip_next();
 
+    // Runs the loop body that follows once per element of obj
+    ValuePtr run_loop(Scope &scope, const std::vector<std::string> &names, const ValuePtr &obj);
+
+    bool contains(const ValuePtr &container, const ValuePtr &value);
+
+    // Generic operators, also used when a specialized node gets other types
+    ValuePtr binary_op(BinaryOpType type, const ValuePtr &left, const ValuePtr &right);
+    bool compare(CompareOpType type, const ValuePtr &left, const ValuePtr &right);
+
+    // Booleans are never modified, so specialized nodes share them
+    const ValuePtr& boolean_value(bool value);
+
     void load_from_module(Scope &scope, const std::string &module, const std::string &name, const std::string &as_name);
     void load_module(Scope &scope, const std::string &name, const std::string &as_name);
 
+    SetPtr read_constant_set();
+
     std::string read_name();
     std::vector<std::string> read_names();
 
+    void assign_names(Scope &scope, const std::vector<std::string> &names, ValuePtr value);
+
+    void track_name(const std::string &name, const ValuePtr &value);
+    void track_subscript(const ValuePtr &container, const ValuePtr &key, const ValuePtr &value, size_t num_reads);
+    void add_read(const InputPath &path, const ValuePtr &value);
+
+    ValuePtr call_pure(const std::shared_ptr<Callable> &function, const ValuePtr *args, uint32_t num_args);
+
     BitStream m_data;
+    std::shared_ptr<const BitStream> m_program;
 
     MemoryManager m_mem;
     Scope *m_global_scope;
 
     std::unordered_map<std::string, ModulePtr> m_loaded_modules;
+
+    struct ConstantSet
+    {
+        SetPtr set;
+        uint32_t end;
+    };
+
+    // Tables of constant in-tests, keyed by their position in the program
+    std::unordered_map<uint32_t, ConstantSet> m_constant_sets;
+
+    struct AttributeCache
+    {
+        ValuePtr module;
+        ValuePtr member;
+        uint32_t end;
+    };
+
+    // Indexed by position; one plus the slot of an attribute access in
+    // m_attribute_caches, or zero. Slots are assigned by prepare()
+    std::vector<uint32_t> m_attribute_positions;
+    std::vector<AttributeCache> m_attribute_caches;
+
+    struct SharedValue
+    {
+        uint32_t index;
+        uint32_t end;
+    };
+
+    // Indexed by position; one plus the entry in m_shared_slots, or zero
+    std::vector<uint32_t> m_shared_positions;
+    std::vector<SharedValue> m_shared_slots;
+    std::vector<ValuePtr> *m_shared_values = nullptr;
+
+    struct ReadEvent
+    {
+        size_t path;
+        ValuePtr value;
+
+        // Only used to get to another value
+        bool subscripted;
+    };
+
+    bool m_track_reads = false;
+    bool m_reads_complete = true;
+
+    // Names the program assigns are never inputs
+    std::set<std::string> m_bound_names;
+
+    std::vector<InputPath> m_read_paths;
+    std::map<InputPath, size_t> m_read_path_indices;
+    std::vector<ReadEvent> m_reads;
+
+    // Values that were read, by address, and their paths
+    std::unordered_map<const Value*, size_t> m_read_values;
+
+    struct PureResult
+    {
+        // Keeps the callable alive, so its address cannot be reused
+        ValuePtr callable;
+        ValuePtr result;
+    };
+
+    // Results of pure calls in this execution, by callable and arguments
+    std::unordered_map<std::string, PureResult> m_pure_results;
+
+    ValuePtr m_true, m_false;
+
+    struct CacheSlot
+    {
+        bool valid = false;
+        ValuePtr value;
+    };
+
+    // Values of CachedValue nodes, see Optimizer
+    std::vector<CacheSlot> m_cache_slots;
 };
 
 }
@@ -17,7 +17,8 @@ public:
         return false;
     }
 
-    virtual ValuePtr next() = 0;
+    // Stores the next element in out, returns false once the iterator is exhausted
+    virtual bool next(ValuePtr &out) = 0;
 
     ValueType type() const override
     {
@@ -42,6 +43,27 @@ protected:
     using Iterator::Iterator;
 };
 
+// Adapter for iterators that still signal their end by throwing
+// stop_iteration_exception from next()
+class LegacyGenerator : public Generator
+{
+public:
+    virtual ValuePtr next() = 0;
+
+    bool next(ValuePtr &out) override
+    {
+        try {
+            out = next();
+            return true;
+        } catch(stop_iteration_exception) {
+            return false;
+        }
+    }
+
+protected:
+    using Generator::Generator;
+};
+
 class IterateableValue : public Value
 {
 public:
@@ -13,7 +13,7 @@ class ListIterator : public Generator
 public:
     ListIterator(MemoryManager& mem, List &list);
 
-    ValuePtr next() override;
+    bool next(ValuePtr &out) override;
 
     ValuePtr duplicate() override;
 
@@ -44,8 +44,12 @@ public:
     void append(ValuePtr val);
 
     const std::vector<ValuePtr>& elements() const;
+    std::vector<ValuePtr>& elements();
+
+protected:
+    // Hook for lists that only materialize their elements on demand
+    virtual void load_all();
 
-private:
     std::vector<ValuePtr> m_elements;
 };
 
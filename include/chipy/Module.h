@@ -22,12 +22,44 @@ public:
 
     ValueType type() const override { return ValueType::Module; }
 
-    virtual ValuePtr get_member(const std::string& name) = 0;
+    // Looks up the member table by default
+    virtual ValuePtr get_member(const std::string& name)
+    {
+        auto it = m_members.find(name);
+        if(it == m_members.end())
+            throw std::runtime_error("No such member: " + name);
+
+        return it->second;
+    }
 
     ValuePtr duplicate() override
     {
         return nullptr; //not supported
     }
+
+    // Do members return the same results for the same arguments every time?
+    // Results of programs that use other modules are never cached
+    virtual bool is_deterministic() const
+    {
+        return true;
+    }
+
+    // Does get_member always return the same value for the same name?
+    // Lets the interpreter look up each member once per execution
+    virtual bool has_fixed_members() const
+    {
+        return false;
+    }
+
+protected:
+    // Members are created once, usually in the constructor
+    void add_member(const std::string &name, ValuePtr value)
+    {
+        m_members[name] = value;
+    }
+
+private:
+    std::unordered_map<std::string, ValuePtr> m_members;
 };
 
 class Function : public Callable
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <type_traits>
+
+#include "chipy/Callable.h"
+#include "chipy/Dictionary.h"
+#include "chipy/List.h"
+
+namespace chipy
+{
+
+// Converts arguments to the C++ types a native function expects
+// The type is checked first, so a static cast is enough to unbox
+template<typename T>
+struct NativeArg;
+
+template<>
+struct NativeArg<ValuePtr>
+{
+    static const ValuePtr& get(const ValuePtr &value) { return value; }
+};
+
+template<>
+struct NativeArg<int32_t>
+{
+    static int32_t get(const ValuePtr &value)
+    {
+        if(!value || value->type() != ValueType::Integer)
+            throw std::runtime_error("Expected an integer argument");
+
+        return static_cast<const IntVal&>(*value).get();
+    }
+};
+
+template<>
+struct NativeArg<bool>
+{
+    static bool get(const ValuePtr &value)
+    {
+        if(!value || value->type() != ValueType::Bool)
+            throw std::runtime_error("Expected a boolean argument");
+
+        return static_cast<const BoolVal&>(*value).get();
+    }
+};
+
+template<>
+struct NativeArg<double>
+{
+    static double get(const ValuePtr &value)
+    {
+        if(value && value->type() == ValueType::Integer)
+            return static_cast<const IntVal&>(*value).get();
+
+        if(!value || value->type() != ValueType::Float)
+            throw std::runtime_error("Expected a float argument");
+
+        return static_cast<const FloatVal&>(*value).get();
+    }
+};
+
+template<>
+struct NativeArg<std::string>
+{
+    static const std::string& get(const ValuePtr &value)
+    {
+        if(!value || value->type() != ValueType::String)
+            throw std::runtime_error("Expected a string argument");
+
+        return static_cast<const StringVal&>(*value).get();
+    }
+};
+
+template<>
+struct NativeArg<ListPtr>
+{
+    static ListPtr get(const ValuePtr &value)
+    {
+        if(!value || value->type() != ValueType::List)
+            throw std::runtime_error("Expected a list argument");
+
+        return std::static_pointer_cast<List>(value);
+    }
+};
+
+template<>
+struct NativeArg<DictionaryPtr>
+{
+    static DictionaryPtr get(const ValuePtr &value)
+    {
+        if(!value || value->type() != ValueType::Dictionary)
+            throw std::runtime_error("Expected a dictionary argument");
+
+        return std::static_pointer_cast<Dictionary>(value);
+    }
+};
+
+// Boxes the return value of a native function
+template<typename T>
+struct NativeResult;
+
+template<>
+struct NativeResult<ValuePtr>
+{
+    static ValuePtr make(MemoryManager&, const ValuePtr &value) { return value; }
+};
+
+template<>
+struct NativeResult<int32_t>
+{
+    static ValuePtr make(MemoryManager &mem, int32_t value) { return mem.create_integer(value); }
+};
+
+template<>
+struct NativeResult<bool>
+{
+    static ValuePtr make(MemoryManager &mem, bool value) { return mem.create_boolean(value); }
+};
+
+template<>
+struct NativeResult<double>
+{
+    static ValuePtr make(MemoryManager &mem, double value) { return mem.create_float(value); }
+};
+
+template<>
+struct NativeResult<std::string>
+{
+    static ValuePtr make(MemoryManager &mem, const std::string &value) { return mem.create_string(value); }
+};
+
+template<uint32_t... I>
+struct ArgIndices {};
+
+template<uint32_t N, uint32_t... I>
+struct MakeArgIndices : MakeArgIndices<N-1, N-1, I...> {};
+
+template<uint32_t... I>
+struct MakeArgIndices<0, I...>
+{
+    typedef ArgIndices<I...> type;
+};
+
+// Calls a C++ function or functor with unboxed arguments
+template<typename F, typename R, typename... Args>
+class NativeFunction : public Callable
+{
+public:
+    static constexpr uint32_t ARITY = sizeof...(Args);
+
+    NativeFunction(MemoryManager &mem, const F &func)
+        : Callable(mem), m_func(func)
+    {}
+
+    ValueType type() const override { return ValueType::Function; }
+
+    ValuePtr duplicate() override
+    {
+        return wrap_value(new (memory_manager()) NativeFunction(memory_manager(), m_func));
+    }
+
+    ValuePtr call(const std::vector<ValuePtr> &args) override
+    {
+        return invoke(args.data(), args.size());
+    }
+
+    ValuePtr invoke(const ValuePtr *args, uint32_t num_args) override
+    {
+        if(num_args != ARITY)
+            throw std::runtime_error("invalid number of arguments");
+
+        return call_with(args, typename MakeArgIndices<ARITY>::type(), std::is_void<R>());
+    }
+
+private:
+    template<uint32_t... I>
+    ValuePtr call_with(const ValuePtr *args, ArgIndices<I...>, std::false_type)
+    {
+        (void)args;
+        return NativeResult<typename std::decay<R>::type>::make(memory_manager(),
+                m_func(NativeArg<typename std::decay<Args>::type>::get(args[I])...));
+    }
+
+    template<uint32_t... I>
+    ValuePtr call_with(const ValuePtr *args, ArgIndices<I...>, std::true_type)
+    {
+        (void)args;
+        m_func(NativeArg<typename std::decay<Args>::type>::get(args[I])...);
+        return memory_manager().create_none();
+    }
+
+    F m_func;
+};
+
+template<typename R, typename... Args>
+ValuePtr bind_function(MemoryManager &mem, R (*func)(Args...))
+{
+    return wrap_value(new (mem) NativeFunction<R (*)(Args...), R, Args...>(mem, func));
+}
+
+template<typename F, typename R, typename... Args>
+ValuePtr bind_functor(MemoryManager &mem, const F &func, R (F::*)(Args...) const)
+{
+    return wrap_value(new (mem) NativeFunction<F, R, Args...>(mem, func));
+}
+
+// Lambdas and other functors with a single call operator
+template<typename F>
+ValuePtr bind_function(MemoryManager &mem, const F &func)
+{
+    return bind_functor(mem, func, &F::operator());
+}
+
+}
@@ -31,7 +31,16 @@ enum class NodeType
     Break,
     Import,
     ImportFrom,
-    Alias
+    Alias,
+    Set,
+    ConstantSet,
+    RangeLoop,
+    ItemsLoop,
+    CachedValue,
+    ClearCache,
+    IntegerBinaryOp,
+    IntegerCompare,
+    StringCompare
 };
 
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <unordered_map>
 #include <vector>
 #include <memory>
@@ -21,6 +22,7 @@ class Tuple;
 class List;
 class BoolVal;
 class FloatVal;
+class Set;
 
 typedef std::shared_ptr<Value> ValuePtr;
 typedef std::shared_ptr<IntVal> IntValPtr;
@@ -30,6 +32,7 @@ typedef std::shared_ptr<StringVal> StringValPtr;
 typedef std::shared_ptr<Tuple> TuplePtr;
 typedef std::shared_ptr<BoolVal> BoolValPtr;
 typedef std::shared_ptr<FloatVal> FloatValPtr;
+typedef std::shared_ptr<Set> SetPtr;
 
 class MemoryManager
 {
@@ -37,36 +40,90 @@ public:
     static constexpr size_t PAGE_SIZE = 1024*1024;
 
     MemoryManager();
+    ~MemoryManager();
 
     MemoryManager(MemoryManager &other) = delete;
 
     void* malloc(size_t sz);
     void free(void* ptr);
 
+    typedef size_t mark_t;
+
+    // Starts a region that can be dropped at once with release()
+    mark_t mark();
+
+    // Reuses the memory allocated since mark, but only if none of it is alive
+    // anymore. Returns false and keeps the memory otherwise
+    bool release(mark_t mark);
+
     IntValPtr create_integer(const int32_t value);
     DictionaryPtr create_dictionary();
     StringValPtr create_string(const std::string &str);
+    StringValPtr create_string(std::string &&str);
+    // Borrows str, which must outlive the value
+    StringValPtr create_string(const std::string *str);
+    StringValPtr create_string(const std::shared_ptr<const std::string> &str);
+    TuplePtr create_tuple(uint32_t size);
     TuplePtr create_tuple(ValuePtr first, ValuePtr second);
     ValuePtr create_from_document(const json::Document &doc);
+    // Converts lazily; doc must outlive the returned value
+    ValuePtr create_document_view(const json::Document &doc);
+    ValuePtr create_from_json(const std::string &text);
     FloatValPtr create_float(const double &f);
     BoolValPtr create_boolean(const bool value);
     ListPtr create_list();
+    // Lists of strings that reference the host's vector instead of copying it
+    ListPtr create_string_list(const std::vector<std::string> *strings);
+    ListPtr create_string_list(const std::shared_ptr<const std::vector<std::string>> &strings);
+    SetPtr create_set();
     ValuePtr create_none();
 
 private:
-    uint8_t *m_buffer;
- //   std::vector<uint8_t> m_buffer;
-    size_t m_buffer_pos;
+    static constexpr size_t ALIGNMENT = 16;
 
-    struct AllocInfo
+    struct Page
     {
-//        page_id_t page;
+        uint8_t *data;
         size_t size;
+        size_t num_allocs;
     };
 
-    void resize(size_t new_size);
+    void next_page(size_t min_size);
+    void add_page(size_t size);
+
+    std::vector<Page> m_pages;
+
+    // Index into m_pages by start address, so free() finds the page of a pointer
+    std::map<const uint8_t*, size_t> m_page_indices;
+    size_t m_current_page;
+    size_t m_buffer_pos;
+    size_t m_num_allocs;
+};
+
+// Frees everything that one record, e.g. an input document, allocated, so an
+// arena that is reused for many records does not grow
+// Each record is marked when it starts, so values the host allocates between
+// records, e.g. modules, are kept
+class RecordMark
+{
+public:
+    void begin(MemoryManager &mem)
+    {
+        m_mark = mem.mark();
+    }
 
-    std::unordered_map<intptr_t, AllocInfo> m_allocs;
+    // Returns false if values of the record are still alive; their memory is
+    // then never reused
+    bool release(MemoryManager &mem)
+    {
+        return mem.release(m_mark);
+    }
+
+    // Like release(), but throws instead
+    void end(MemoryManager &mem);
+
+private:
+    MemoryManager::mark_t m_mark = 0;
 };
 
 class Object
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <set>
+#include <string>
+
+#include "chipy/Value.h"
+
+namespace chipy
+{
+
+// Avoids evaluating the same expression more than once
+//
+// Expressions in a loop that only read names the loop does not assign are
+// evaluated at most once each time the loop runs (loop-invariant code
+// motion). Expressions that repeat within a block are evaluated once until
+// a statement changes what they read (common subexpression elimination).
+//
+// Instead of moving an expression in front of the loop, which would run it
+// even when the loop body does not, every occurrence reuses the value of
+// the first one evaluated. Errors and reads thus happen as before.
+//
+// Subscripts, attributes and calls of builtins or of functions marked as
+// pure have no effects. Any other call is opaque and might change any
+// value, so no value is reused across it. Programs that modify values,
+// e.g. with list.append(), are left as they are
+class Optimizer
+{
+public:
+    Optimizer(const BitStream &program);
+
+    // Calls of name have no effects, e.g. functions wrapped by FunctionCache
+    // Members of modules are given as module.function
+    void add_pure_function(const std::string &name);
+
+    BitStream optimize();
+
+    // Expressions that are evaluated once per loop
+    uint32_t num_hoisted() const
+    {
+        return m_num_hoisted;
+    }
+
+    // Occurrences that reuse the value of an earlier one in the same block
+    uint32_t num_eliminated() const
+    {
+        return m_num_eliminated;
+    }
+
+private:
+    BitStream m_program;
+    std::set<std::string> m_pure_functions;
+
+    uint32_t m_num_hoisted = 0;
+    uint32_t m_num_eliminated = 0;
+};
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "chipy/BatchEvaluator.h"
+
+namespace chipy
+{
+
+// Evaluates one program over many documents on a pool of threads
+// Every worker has its own interpreter and MemoryManager, and all of them
+// share the compiled program. Work is split into chunks that idle workers
+// steal from busy ones
+// Not available in the enclave build
+class ParallelEvaluator
+{
+public:
+    ParallelEvaluator(const BitStream &program, const std::string &input_name, uint32_t num_threads = 0);
+    ~ParallelEvaluator();
+
+    // Runs fn on the interpreter of every worker, e.g. to set modules
+    // Must not be called while an evaluation is running; between evaluations
+    // is fine, as every record is marked when it starts, see RecordMark
+    void setup(const std::function<void(Interpreter&)> &fn);
+
+    // One bit per document; only one evaluation can run at a time
+    std::vector<bool> evaluate(const json::Document *docs, size_t count);
+    std::vector<bool> evaluate(const std::vector<json::Document> &docs);
+
+    uint32_t num_threads() const
+    {
+        return m_workers.size();
+    }
+
+private:
+    struct Chunk
+    {
+        size_t begin, end;
+    };
+
+    struct Worker
+    {
+        Worker(const std::shared_ptr<const BitStream> &program, const std::string &input_name)
+            : evaluator(program, input_name)
+        {}
+
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+        BatchEvaluator evaluator;
+        std::thread thread;
+    };
+
+    void run(uint32_t index);
+    bool pop_chunk(uint32_t index, Chunk &chunk);
+    bool steal_chunk(uint32_t index, Chunk &chunk);
+    void process(Worker &worker, const Chunk &chunk);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work_cond;
+    std::condition_variable m_done_cond;
+
+    uint64_t m_generation = 0;
+    uint32_t m_active_workers = 0;
+    bool m_stop = false;
+
+    const json::Document *m_docs = nullptr;
+    uint8_t *m_results = nullptr;
+
+    std::exception_ptr m_error;
+};
+
+}
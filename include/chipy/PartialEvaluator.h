@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "chipy/Value.h"
+
+namespace chipy
+{
+
+struct Node;
+
+// Specializes a program for globals that stay the same across many
+// executions, e.g. the configuration of a tenant
+//
+// Known strings, integers and booleans replace the names that refer to
+// them. Comparisons, boolean operations and lookups in known containers
+// that only depend on constants are folded, and branches whose condition
+// became constant are removed. Known values that are still used afterwards
+// are assigned at the start of the residual program, so it only needs the
+// remaining inputs to be bound
+class PartialEvaluator
+{
+public:
+    PartialEvaluator(const BitStream &program);
+
+    // Supports None, booleans, integers, strings and containers of them
+    // Floats cannot be written as literals and are rejected
+    void set_value(const std::string &name, const ValuePtr &value);
+
+    void set_string(const std::string &name, const std::string &value);
+    void set_list(const std::string &name, const std::vector<std::string> &list);
+    void set_set(const std::string &name, const std::vector<std::string> &elements);
+
+    BitStream specialize() const;
+
+private:
+    BitStream m_program;
+
+    // Known values as literals
+    std::map<std::string, std::shared_ptr<Node>> m_known;
+};
+
+}
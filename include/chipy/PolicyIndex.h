@@ -0,0 +1,89 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "chipy/PolicySet.h"
+
+namespace chipy
+{
+
+// A condition of the form `path == constant` on the input
+struct Guard
+{
+    InputPath path;
+
+    bool is_string;
+    std::string string_value;
+    int32_t integer_value;
+};
+
+struct PolicyGuards
+{
+    // Empty if the program has no guards that can be used
+    std::vector<Guard> guards;
+
+    // What the program returns when one of the guards does not hold
+    bool default_result = false;
+};
+
+// Finds the equality tests a program starts with, e.g. the first two
+// conditions of `if request['op'] == 'put' and request['table'] == 'users' and ...:`
+// If the input has all guarded paths and one of the tests fails, the
+// program returns default_result without evaluating anything else
+PolicyGuards analyze_guards(const BitStream &program, const std::string &input_name);
+
+// Runs only the programs whose guards can hold for an input
+//
+// Programs are grouped by the paths their guards test, and each group is
+// hashed by the values of those paths. An input then costs one lookup per
+// group plus the programs that actually match
+class PolicyIndex
+{
+public:
+    PolicyIndex(const std::vector<BitStream> &programs, const std::string &input_name);
+
+    // One result per program, in the order they were given
+    std::vector<bool> evaluate(const json::Document &doc);
+
+    // Indices of the programs that have to run for doc, in order
+    std::vector<size_t> candidates(const json::Document &doc) const;
+
+    size_t size() const
+    {
+        return m_policies.size();
+    }
+
+    // Number of programs that always have to run
+    size_t num_unindexed() const
+    {
+        return m_unindexed.size();
+    }
+
+    PolicySet& policies()
+    {
+        return m_policies;
+    }
+
+private:
+    struct Group
+    {
+        // Indices into m_paths
+        std::vector<size_t> paths;
+
+        // Programs by the values of their guards
+        std::unordered_map<std::string, std::vector<size_t>> policies;
+
+        // Used when the input does not decide the guards
+        std::vector<size_t> all;
+    };
+
+    PolicySet m_policies;
+
+    std::vector<InputPath> m_paths;
+    std::vector<Group> m_groups;
+    std::vector<size_t> m_unindexed;
+
+    std::vector<bool> m_defaults;
+};
+
+}
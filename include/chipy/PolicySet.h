@@ -0,0 +1,71 @@
+#pragma once
+
+#include "chipy/Interpreter.h"
+
+namespace chipy
+{
+
+// Evaluates many programs against the same input
+//
+// The input is converted once and bound to all programs that cannot modify
+// it. Pure boolean expressions, e.g. request['method'] == 'GET', that occur
+// more than once across those programs are evaluated at most once per input
+class PolicySet
+{
+public:
+    PolicySet(const std::vector<BitStream> &programs, const std::string &input_name);
+
+    // One result per program, in the order they were given
+    std::vector<bool> evaluate(const json::Document &doc);
+
+    // Only runs the programs listed in indices
+    // The other entries of results are left as they are
+    void evaluate(const json::Document &doc, const std::vector<size_t> &indices, std::vector<bool> &results);
+
+    size_t size() const
+    {
+        return m_policies.size();
+    }
+
+    // Modules set here are kept across inputs
+    Interpreter& interpreter(size_t index)
+    {
+        return *m_policies[index].interpreter;
+    }
+
+    // Number of distinct expressions that are shared
+    size_t num_shared_expressions() const
+    {
+        return m_shared_values.size();
+    }
+
+private:
+    struct Policy
+    {
+        std::unique_ptr<Interpreter> interpreter;
+
+        // Programs that might modify their input get a copy of their own
+        bool isolated;
+        InputSet inputs;
+
+        RecordMark record;
+    };
+
+    void run(const json::Document &doc, const std::vector<size_t> &indices, std::vector<bool> &results);
+    // Returns false if values of the input are still alive
+    bool release(const std::vector<size_t> &indices);
+
+    const std::string m_input_name;
+    std::vector<Policy> m_policies;
+    std::vector<size_t> m_all;
+
+    // Union of the inputs of all programs that are not isolated
+    InputSet m_inputs;
+    MemoryManager m_mem;
+
+    std::vector<ValuePtr> m_shared_values;
+
+    RecordMark m_record;
+};
+
+}
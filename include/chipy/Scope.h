@@ -1,6 +1,7 @@
 #pragma once
 
 #include "List.h"
+#include "Set.h"
 #include "Tuple.h"
 #include "Value.h"
 #include "Dictionary.h"
@@ -11,26 +12,36 @@ namespace chipy
 class Scope : public Object
 {
 public:
-    const std::string BUILTIN_STR_NONE = "None";
-    const std::string BUILTIN_STR_RANGE = "range";
-    const std::string BUILTIN_STR_MAKE_INT = "int";
-    const std::string BUILTIN_STR_MAKE_STR = "str";
-    const std::string BUILTIN_STR_PRINT = "print";
-
-    Scope(MemoryManager &mem) : Object(mem), m_parent(nullptr) {}
+    static const std::string BUILTIN_STR_NONE;
+    static const std::string BUILTIN_STR_RANGE;
+    static const std::string BUILTIN_STR_MAKE_INT;
+    static const std::string BUILTIN_STR_MAKE_STR;
+    static const std::string BUILTIN_STR_PRINT;
+    static const std::string BUILTIN_STR_MAKE_SET;
+
+    Scope(MemoryManager &mem);
     Scope(MemoryManager &mem, Scope &parent) : Object(mem), m_parent(&parent) {}
 
     ValuePtr get_value(const std::string &id);
     void set_value(const std::string &name, ValuePtr value);
     bool has_value(const std::string &name) const;
     void terminate();
+
+    // Removes all values and undoes terminate()
+    void clear();
     bool is_terminated() const;
 
+    // Names of None and the builtins, which are used unless a scope binds the same name
+    static bool is_builtin_name(const std::string &id);
+
 private:
     Scope *m_parent;
     bool m_terminated = false;
 
     std::unordered_map<std::string, ValuePtr> m_values;
+
+    // Builtins are stateless, so the global scope creates them once
+    std::unordered_map<std::string, ValuePtr> m_builtins;
 };
 
 }
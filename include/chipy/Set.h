@@ -0,0 +1,108 @@
+#pragma once
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "Iterator.h"
+
+namespace chipy
+{
+
+class Set;
+typedef std::shared_ptr<Set> SetPtr;
+
+class SetIterator : public Generator
+{
+public:
+    SetIterator(MemoryManager &mem, Set &set);
+
+    bool next(ValuePtr &out) override;
+
+    ValuePtr duplicate() override;
+
+private:
+    Set &m_set;
+    uint32_t m_pos;
+};
+
+// Open addressing table of packed integers
+// Slots are probed a group of four at a time, with SSE2 where available
+class IntTable
+{
+public:
+    // Returns false if the value was already present
+    bool insert(int32_t value);
+    bool contains(int32_t value) const;
+
+private:
+    static constexpr uint32_t GROUP_SIZE = 4;
+
+    // Marks unused slots; whether the set holds this value is kept separately
+    static constexpr int32_t EMPTY = std::numeric_limits<int32_t>::min();
+
+    void grow();
+
+    std::vector<int32_t> m_slots;
+    uint32_t m_size = 0;
+    bool m_has_empty = false;
+};
+
+// Open addressing table of strings
+// Each slot keeps seven bits of its hash, so a probe compares sixteen slots
+// at a time, with SSE2 where available, and only compares the strings of
+// slots whose bits match
+class StringTable
+{
+public:
+    // Returns false if the value was already present
+    bool insert(const std::string &value);
+    bool contains(const std::string &value) const;
+
+private:
+    static constexpr uint32_t GROUP_SIZE = 16;
+
+    void grow();
+
+    // Zero for unused slots, otherwise the top bit and seven bits of the hash
+    std::vector<uint8_t> m_tags;
+    std::vector<std::string> m_slots;
+    uint32_t m_size = 0;
+};
+
+// Integers and strings are hashed in separate tables, so membership
+// tests never have to box the probe or compare across types
+// Integral floats are probed as integers
+class Set : public IterateableValue
+{
+public:
+    Set(MemoryManager &mem)
+        : IterateableValue(mem)
+    {}
+
+    IteratorPtr iterate() override;
+
+    ValuePtr duplicate() override;
+
+    ValueType type() const override;
+
+    uint32_t size() const override;
+
+    // Returns false if the value was already present
+    bool insert(ValuePtr value);
+
+    bool contains(const Value &value) const;
+    bool contains(int32_t value) const;
+    bool contains(const std::string &value) const;
+
+    const std::vector<ValuePtr>& elements() const;
+
+private:
+    IntTable m_integers;
+    StringTable m_strings;
+
+    // Keeps insertion order and lets iteration hand out the stored values
+    std::vector<ValuePtr> m_elements;
+};
+
+}
@@ -1,16 +1,37 @@
 #pragma once
 
+#include <new>
+
 #include "Value.h"
 
 namespace chipy
 {
 
+// The elements are stored right behind the object, so a tuple of any
+// arity only needs a single allocation
 class Tuple : public Value
 {
 public:
-    Tuple(MemoryManager &mem, ValuePtr first, ValuePtr second)
-        : Value(mem), m_first(first), m_second(second)
+    static void* operator new(std::size_t sz, MemoryManager &mem_mgr, uint32_t size)
+    {
+        return mem_mgr.malloc(sz + size * sizeof(ValuePtr));
+    }
+
+    Tuple(MemoryManager &mem, uint32_t size)
+        : Value(mem), m_size(size)
+    {
+        for(uint32_t i = 0; i < m_size; ++i)
+        {
+            new (&elements()[i]) ValuePtr(nullptr);
+        }
+    }
+
+    ~Tuple()
     {
+        for(uint32_t i = 0; i < m_size; ++i)
+        {
+            elements()[i].~ValuePtr();
+        }
     }
 
     ValueType type() const override
@@ -20,22 +41,59 @@ public:
 
     ValuePtr duplicate() override
     {
-        return ValuePtr(new (memory_manager()) Tuple(memory_manager(), m_first, m_second));
+        auto t = wrap_value(new (memory_manager(), m_size) Tuple(memory_manager(), m_size));
+
+        for(uint32_t i = 0; i < m_size; ++i)
+        {
+            t->set(i, get(i));
+        }
+
+        return t;
+    }
+
+    uint32_t size() const
+    {
+        return m_size;
+    }
+
+    ValuePtr get(uint32_t index) const
+    {
+        if(index >= m_size)
+            throw std::runtime_error("Tuple index out of range");
+
+        return elements()[index];
+    }
+
+    void set(uint32_t index, ValuePtr value)
+    {
+        if(index >= m_size)
+            throw std::runtime_error("Tuple index out of range");
+
+        elements()[index] = value;
     }
 
     ValuePtr first()
     {
-        return m_first;
+        return get(0);
     }
 
     ValuePtr second()
     {
-        return m_second;
+        return get(1);
     }
 
 private:
-    ValuePtr m_first;
-    ValuePtr m_second;
+    ValuePtr* elements()
+    {
+        return reinterpret_cast<ValuePtr*>(this + 1);
+    }
+
+    const ValuePtr* elements() const
+    {
+        return reinterpret_cast<const ValuePtr*>(this + 1);
+    }
+
+    const uint32_t m_size;
 };
 
 typedef std::shared_ptr<Tuple> TuplePtr;
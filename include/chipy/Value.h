@@ -1,8 +1,10 @@
 #pragma once
 
+#include <limits>
 #include <memory>
 #include <stdint.h>
 #include <string>
+#include <utility>
 #include "json/json.h"
 #include "Object.h"
 
@@ -25,7 +27,8 @@ enum class ValueType
     Tuple,
     Alias,
     Module,
-    Function
+    Function,
+    Set
 };
 
 class Value;
@@ -144,14 +147,55 @@ public:
     bool bool_test() const override { return m_value; }
 };
 
-class StringVal : public PlainValue<std::string, ValueType::String>
+// Strings either own their contents or refer to memory owned by the host
+class StringVal : public Value
 {
 public:
     StringVal(MemoryManager &mem, const std::string &val)
-        : PlainValue(mem, val) {}
+        : Value(mem), m_value(val), m_external(nullptr) {}
+
+    StringVal(MemoryManager &mem, std::string &&val)
+        : Value(mem), m_value(std::move(val)), m_external(nullptr) {}
+
+    // Refers to val without copying it; val must outlive this value
+    StringVal(MemoryManager &mem, const std::string *val)
+        : Value(mem), m_external(val) {}
+
+    // Keeps the host's buffer alive for as long as the value exists
+    StringVal(MemoryManager &mem, const std::shared_ptr<const std::string> &val)
+        : Value(mem), m_external(val.get()), m_shared(val) {}
+
+    ValueType type() const override
+    {
+        return ValueType::String;
+    }
 
     ValuePtr duplicate() override
-    { return wrap_value(new (memory_manager()) StringVal(memory_manager(), m_value)); }
+    {
+        if(m_shared)
+            return wrap_value(new (memory_manager()) StringVal(memory_manager(), m_shared));
+        else if(m_external)
+            return wrap_value(new (memory_manager()) StringVal(memory_manager(), m_external));
+        else
+            return wrap_value(new (memory_manager()) StringVal(memory_manager(), m_value));
+    }
+
+    const std::string& get() const
+    {
+        return m_external ? *m_external : m_value;
+    }
+
+    void set(const std::string &v)
+    {
+        m_value = v;
+        m_external = nullptr;
+        m_shared.reset();
+    }
+
+private:
+    std::string m_value;
+    const std::string *m_external;
+    std::shared_ptr<const std::string> m_shared;
 };
 
 class FloatVal : public PlainValue<double, ValueType::Float>
@@ -196,12 +240,45 @@ std::shared_ptr<T> value_cast(ValuePtr val)
 }
 
 
+// type() identifies the class of plain values, so the operators below
+// do not need dynamic_cast once they checked it
+
+// Integers and floats compare by value, e.g. 1 == 1.0 and 1 < 1.5, also in
+// membership tests. Booleans are not numbers
+
+inline bool is_number(const Value &value)
+{
+    return value.type() == ValueType::Integer || value.type() == ValueType::Float;
+}
+
+// Mixed integer and float comparisons are done in double precision, which is exact for int32
+inline double number_value(const Value &value)
+{
+    if(value.type() == ValueType::Integer)
+        return static_cast<const IntVal&>(value).get();
+    else
+        return static_cast<const FloatVal&>(value).get();
+}
+
+// Finds the int32 that f is equal to, so that tables of integers also find
+// equal floats. NaN and floats that are not whole numbers have none
+inline bool integer_value(double f, int32_t &out)
+{
+    if(!(f >= std::numeric_limits<int32_t>::min() && f <= std::numeric_limits<int32_t>::max()))
+        return false;
+
+    out = static_cast<int32_t>(f);
+    return out == f;
+}
+
 inline bool operator>(const Value &first, const Value &second)
 {
     if(first.type() == ValueType::Integer && second.type() == ValueType::Integer)
     {
-        return dynamic_cast<const IntVal&>(first).get() > dynamic_cast<const IntVal&>(second).get();
+        return static_cast<const IntVal&>(first).get() > static_cast<const IntVal&>(second).get();
     }
+    else if(is_number(first) && is_number(second))
+        return number_value(first) > number_value(second);
     else
         return false;
 }
@@ -210,8 +287,10 @@ inline bool operator>=(const Value &first, const Value &second)
 {
     if(first.type() == ValueType::Integer && second.type() == ValueType::Integer)
     {
-        return dynamic_cast<const IntVal&>(first).get() >= dynamic_cast<const IntVal&>(second).get();
+        return static_cast<const IntVal&>(first).get() >= static_cast<const IntVal&>(second).get();
     }
+    else if(is_number(first) && is_number(second))
+        return number_value(first) >= number_value(second);
     else
         return false;
 }
@@ -220,12 +299,14 @@ inline bool operator==(const Value &first, const Value &second)
 {
     if(first.type() == ValueType::String && second.type() == ValueType::String)
     {
-        return dynamic_cast<const StringVal&>(first).get() == dynamic_cast<const StringVal&>(second).get();
+        return static_cast<const StringVal&>(first).get() == static_cast<const StringVal&>(second).get();
     }
     else if(first.type() == ValueType::Integer && second.type() == ValueType::Integer)
     {
-        return dynamic_cast<const IntVal&>(first).get() == dynamic_cast<const IntVal&>(second).get();
+        return static_cast<const IntVal&>(first).get() == static_cast<const IntVal&>(second).get();
     }
+    else if(is_number(first) && is_number(second))
+        return number_value(first) == number_value(second);
     else
         return false;
 }
@@ -1,6 +1,13 @@
 #pragma once
 
 #include "Interpreter.h"
+#include "BatchEvaluator.h"
+#include "ColumnarEvaluator.h"
+#include "PolicyIndex.h"
+#include "PartialEvaluator.h"
+#include "Optimizer.h"
+#include "NativeFunction.h"
+#include "CppObject.h"
 #include <json/json.h>
 
 namespace chipy
@@ -8,6 +15,9 @@ namespace chipy
 
 json::Document value_to_document(ValuePtr val);
 
+// Appends val as JSON text to out
+void value_to_json(const ValuePtr &val, std::string &out);
+
 BitStream compile_file(const std::string &filename);
 BitStream compile_code(const std::string &code);
 
@@ -1,3 +1,6 @@
+#include <map>
+#include <set>
+
 #include "json/BitStream.h"
 #include "chipy/NodeType.h"
 
@@ -63,6 +66,28 @@ private:
     std::vector<std::string> m_code;
 };
 
+// Type of an expression as far as the compiler can tell from the code alone
+// These are guesses, as the host might bind any value to a name, so the
+// interpreter checks the actual types before using a specialized operation
+enum class StaticType
+{
+    // Not known yet, while types of names are inferred
+    Unset,
+    Integer,
+    String,
+    Unknown
+};
+
+static StaticType join(StaticType a, StaticType b)
+{
+    if(a == StaticType::Unset)
+        return b;
+    else if(b == StaticType::Unset || a == b)
+        return a;
+    else
+        return StaticType::Unknown;
+}
+
 class Compiler
 {
 public:
@@ -72,6 +97,7 @@ public:
 
     void run()
     {
+        infer_name_types(*(m_ast->body));
         parse_next(*(m_ast->body));
     }
 
@@ -114,6 +140,311 @@ private:
         }
     }
 
+    // Names that are only ever assigned integers or only strings
+    void infer_name_types(const pypa::Ast &body)
+    {
+        collect_assignments(body);
+
+        // Loops over range() are only counted loops if range is the builtin
+        if(m_assignments.count("range"))
+        {
+            m_range_assigned = true;
+            m_assignments.clear();
+            m_name_types.clear();
+            collect_assignments(body);
+        }
+
+        // Names start out unset, so that names assigned from each other resolve
+        bool changed = true;
+
+        while(changed)
+        {
+            changed = false;
+
+            for(auto &it: m_assignments)
+            {
+                auto &type = m_name_types[it.first];
+                auto result = type;
+
+                for(auto &assignment: it.second)
+                    result = join(result, assignment.value ? infer_type(*assignment.value) : assignment.type);
+
+                if(result != type)
+                {
+                    type = result;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    void collect_assignments(const pypa::Ast &stmt)
+    {
+        switch(stmt.type)
+        {
+        case pypa::AstType::Suite:
+            for(auto &item: reinterpret_cast<const pypa::AstSuite&>(stmt).items)
+                collect_assignments(*item);
+            break;
+        case pypa::AstType::Assign:
+        {
+            auto &assign = reinterpret_cast<const pypa::AstAssign&>(stmt);
+
+            for(auto &target: assign.targets)
+            {
+                if(target->type == pypa::AstType::Name)
+                    add_assignment(*target, StaticType::Unset, assign.value.get());
+                else
+                    add_assignment(*target, StaticType::Unknown);
+            }
+            break;
+        }
+        case pypa::AstType::AugAssign:
+            // Only integers can be added in place
+            add_assignment(*reinterpret_cast<const pypa::AstAugAssign&>(stmt).target, StaticType::Integer);
+            break;
+        case pypa::AstType::For:
+        {
+            auto &loop = reinterpret_cast<const pypa::AstFor&>(stmt);
+            add_assignment(*loop.target, is_range_call(*loop.iter) ? StaticType::Integer : StaticType::Unknown);
+            collect_assignments(*loop.body);
+            break;
+        }
+        case pypa::AstType::While:
+            collect_assignments(*reinterpret_cast<const pypa::AstWhile&>(stmt).body);
+            break;
+        case pypa::AstType::If:
+        {
+            auto &ifclause = reinterpret_cast<const pypa::AstIf&>(stmt);
+            collect_assignments(*ifclause.body);
+
+            if(ifclause.orelse)
+                collect_assignments(*ifclause.orelse);
+            break;
+        }
+        case pypa::AstType::Import:
+            add_assignment(*reinterpret_cast<const pypa::AstImport&>(stmt).names, StaticType::Unknown);
+            break;
+        case pypa::AstType::ImportFrom:
+            add_assignment(*reinterpret_cast<const pypa::AstImportFrom&>(stmt).names, StaticType::Unknown);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // value is only set for names that are assigned an expression
+    void add_assignment(const pypa::AstExpr &target, StaticType type, const pypa::AstExpr *value = nullptr)
+    {
+        switch(target.type)
+        {
+        case pypa::AstType::Name:
+        {
+            std::string name = reinterpret_cast<const pypa::AstName&>(target).id.c_str();
+            m_assignments[name].push_back(Assignment{type, value});
+            m_name_types.emplace(name, StaticType::Unset);
+            break;
+        }
+        case pypa::AstType::Alias:
+        {
+            auto &alias = reinterpret_cast<const pypa::AstAlias&>(target);
+            add_assignment(alias.as_name ? *alias.as_name : *alias.name, type);
+            break;
+        }
+        case pypa::AstType::Tuple:
+            for(auto &elem: reinterpret_cast<const pypa::AstTuple&>(target).elements)
+                add_assignment(*elem, type);
+            break;
+        default:
+            break;
+        }
+    }
+
+    StaticType infer_type(const pypa::AstExpr &expr) const
+    {
+        switch(expr.type)
+        {
+        case pypa::AstType::Number:
+            if(reinterpret_cast<const pypa::AstNumber&>(expr).num_type == pypa::AstNumber::Integer)
+                return StaticType::Integer;
+            else
+                return StaticType::Unknown;
+        case pypa::AstType::Str:
+            return StaticType::String;
+        case pypa::AstType::Name:
+        {
+            // Names the program never assigns are bound by the host
+            auto it = m_name_types.find(reinterpret_cast<const pypa::AstName&>(expr).id.c_str());
+            return it == m_name_types.end() ? StaticType::Unknown : it->second;
+        }
+        case pypa::AstType::BinOp:
+        {
+            auto &op = reinterpret_cast<const pypa::AstBinOp&>(expr);
+            auto left = infer_type(*op.left);
+            auto right = infer_type(*op.right);
+
+            if(op.op != pypa::AstBinOpType::Add && op.op != pypa::AstBinOpType::Sub
+               && op.op != pypa::AstBinOpType::Mult)
+                return StaticType::Unknown;
+
+            // Either the other operand has the same type or the operation fails
+            if(left == StaticType::String || right == StaticType::String)
+            {
+                if(op.op == pypa::AstBinOpType::Add && left != StaticType::Integer && right != StaticType::Integer)
+                    return StaticType::String;
+                else
+                    return StaticType::Unknown;
+            }
+
+            if(left == StaticType::Integer || right == StaticType::Integer)
+                return StaticType::Integer;
+
+            return (left == StaticType::Unset || right == StaticType::Unset) ? StaticType::Unset : StaticType::Unknown;
+        }
+        default:
+            return StaticType::Unknown;
+        }
+    }
+
+    // Types that are still unset belong to names that are only assigned from each other
+    StaticType known_type(const pypa::AstExpr &expr) const
+    {
+        auto type = infer_type(expr);
+        return type == StaticType::Unset ? StaticType::Unknown : type;
+    }
+
+    bool is_range_call(const pypa::AstExpr &expr) const
+    {
+        if(m_range_assigned || expr.type != pypa::AstType::Call)
+            return false;
+
+        auto &call = reinterpret_cast<const pypa::AstCall&>(expr);
+        auto num_args = call.arglist.arguments.size();
+
+        return call.function->type == pypa::AstType::Name
+            && std::string(reinterpret_cast<const pypa::AstName&>(*call.function).id.c_str()) == "range"
+            && num_args >= 1 && num_args <= 3;
+    }
+
+    // A single comparison with an integer or string operand, e.g. x > 10
+    bool parse_specialized_compare(const pypa::AstCompare &comp)
+    {
+        if(comp.comparators.size() != 1)
+            return false;
+
+        auto op = comp.operators[0];
+        auto left = known_type(*comp.left);
+        auto right = known_type(*comp.comparators[0]);
+
+        bool equality = (op == pypa::AstCompareOpType::Equals || op == pypa::AstCompareOpType::NotEqual);
+        bool ordering = (op == pypa::AstCompareOpType::Less || op == pypa::AstCompareOpType::LessEqual
+                         || op == pypa::AstCompareOpType::More || op == pypa::AstCompareOpType::MoreEqual);
+
+        if((equality || ordering) && (left == StaticType::Integer || right == StaticType::Integer))
+            m_result << NodeType::IntegerCompare;
+        else if(equality && (left == StaticType::String || right == StaticType::String))
+            m_result << NodeType::StringCompare;
+        else
+            return false;
+
+        parse_next(*comp.left);
+        m_result << op;
+        parse_next(*comp.comparators[0]);
+        return true;
+    }
+
+    // Membership tests against a literal list of constants are emitted as a
+    // sorted, deduplicated table that the interpreter only hashes once
+    bool parse_constant_set(const pypa::AstExpr &expr)
+    {
+        if(expr.type != pypa::AstType::List)
+            return false;
+
+        auto &list = reinterpret_cast<const pypa::AstList&>(expr);
+
+        std::set<int32_t> integers;
+        std::set<std::string> strings;
+
+        for(auto &elem: list.elements)
+        {
+            if(elem->type == pypa::AstType::Str)
+            {
+                strings.insert(reinterpret_cast<const pypa::AstStr&>(*elem).value.c_str());
+            }
+            else if(elem->type == pypa::AstType::Number
+                    && reinterpret_cast<const pypa::AstNumber&>(*elem).num_type == pypa::AstNumber::Integer)
+            {
+                int32_t i = reinterpret_cast<const pypa::AstNumber&>(*elem).integer;
+                integers.insert(i);
+            }
+            else
+                return false;
+        }
+
+        m_result << NodeType::ConstantSet;
+
+        m_result << static_cast<uint32_t>(integers.size());
+        for(auto i: integers)
+            m_result << i;
+
+        m_result << static_cast<uint32_t>(strings.size());
+        for(auto &str: strings)
+            m_result << str;
+
+        return true;
+    }
+
+    // for <name> in range(...) becomes a counted loop that keeps the counter unboxed
+    // The interpreter still checks that range is the builtin, as the host may bind it
+    bool parse_range_loop(const pypa::AstFor &loop)
+    {
+        if(loop.target->type != pypa::AstType::Name || !is_range_call(*loop.iter))
+            return false;
+
+        auto &args = reinterpret_cast<const pypa::AstCall&>(*loop.iter).arglist.arguments;
+
+        std::string name = reinterpret_cast<const pypa::AstName&>(*loop.target).id.c_str();
+
+        m_result << NodeType::RangeLoop << name;
+        parse_expr_list(args);
+        parse_next(*loop.body);
+        return true;
+    }
+
+    // for k, v in d.items() binds key and value directly instead of unpacking tuples
+    bool parse_items_loop(const pypa::AstFor &loop)
+    {
+        if(loop.target->type != pypa::AstType::Tuple || loop.iter->type != pypa::AstType::Call)
+            return false;
+
+        auto &target = reinterpret_cast<const pypa::AstTuple&>(*loop.target);
+        auto &call = reinterpret_cast<const pypa::AstCall&>(*loop.iter);
+
+        if(target.elements.size() != 2 || !call.arglist.arguments.empty()
+                || call.function->type != pypa::AstType::Attribute)
+            return false;
+
+        for(auto &elem: target.elements)
+        {
+            if(elem->type != pypa::AstType::Name)
+                return false;
+        }
+
+        auto &attr = reinterpret_cast<const pypa::AstAttribute&>(*call.function);
+
+        if(attr.attribute->type != pypa::AstType::Name
+                || std::string(reinterpret_cast<const pypa::AstName&>(*attr.attribute).id.c_str()) != "items")
+            return false;
+
+        std::string key_name = reinterpret_cast<const pypa::AstName&>(*target.elements[0]).id.c_str();
+        std::string value_name = reinterpret_cast<const pypa::AstName&>(*target.elements[1]).id.c_str();
+
+        m_result << NodeType::ItemsLoop << key_name << value_name;
+        parse_next(*attr.value);
+        parse_next(*loop.body);
+        return true;
+    }
+
     void parse_next(const pypa::Ast &stmt)
     {
         switch(stmt.type)
@@ -203,6 +534,10 @@ private:
         case pypa::AstType::Compare:
         {
             auto &comp = reinterpret_cast<const pypa::AstCompare&>(stmt);
+
+            if(parse_specialized_compare(comp))
+                break;
+
             m_result << NodeType::Compare;
             parse_next(*comp.left);
 
@@ -210,7 +545,13 @@ private:
             m_result << size;
             for(uint32_t i = 0; i < size; ++i)
             {
-                m_result << comp.operators[i];
+                auto op = comp.operators[i];
+                m_result << op;
+
+                if((op == pypa::AstCompareOpType::In || op == pypa::AstCompareOpType::NotIn)
+                    && parse_constant_set(*comp.comparators[i]))
+                    continue;
+
                 parse_next(*comp.comparators[i]);
             }
 
@@ -286,7 +627,13 @@ private:
         case pypa::AstType::BinOp:
         {
             auto &op = reinterpret_cast<const pypa::AstBinOp&>(stmt);
-            m_result << NodeType::BinaryOp;
+
+            // Only integers are added, subtracted and multiplied without allocating
+            if(known_type(op) == StaticType::Integer)
+                m_result << NodeType::IntegerBinaryOp;
+            else
+                m_result << NodeType::BinaryOp;
+
             m_result << op.op;
             parse_next(*op.left);
             parse_next(*op.right);
@@ -300,6 +647,13 @@ private:
             parse_expr_list(list.elements);
             break;
         }
+        case pypa::AstType::Set:
+        {
+            auto &set = reinterpret_cast<const pypa::AstSet&>(stmt);
+            m_result << NodeType::Set;
+            parse_expr_list(set.elements);
+            break;
+        }
         case pypa::AstType::Subscript:
         {
             auto &subs = reinterpret_cast<const pypa::AstSubscript&>(stmt);
@@ -318,6 +672,10 @@ private:
         case pypa::AstType::For:
         {
             auto &loop = reinterpret_cast<const pypa::AstFor&>(stmt);
+
+            if(parse_range_loop(loop) || parse_items_loop(loop))
+                break;
+
             m_result << NodeType::ForLoop;
             parse_next(*loop.target);
             parse_next(*loop.iter);
@@ -376,6 +734,19 @@ private:
 
     const pypa::AstModulePtr m_ast;
 
+    struct Assignment
+    {
+        // Type of the value if it is not an expression
+        StaticType type;
+        const pypa::AstExpr *value;
+    };
+
+    std::map<std::string, std::vector<Assignment>> m_assignments;
+    std::map<std::string, StaticType> m_name_types;
+
+    // Does the program bind range itself?
+    bool m_range_assigned = false;
+
     BitStream m_result;
 };
 
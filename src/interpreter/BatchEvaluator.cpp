@@ -0,0 +1,58 @@
+#include "chipy/BatchEvaluator.h"
+
+namespace chipy
+{
+
+BatchEvaluator::BatchEvaluator(const BitStream &program, const std::string &input_name)
+    : m_interpreter(program), m_input_name(input_name), m_inputs(analyze_inputs(program))
+{
+    m_interpreter.prepare();
+}
+
+BatchEvaluator::BatchEvaluator(const std::shared_ptr<const BitStream> &program, const std::string &input_name)
+    : m_interpreter(program), m_input_name(input_name), m_inputs(analyze_inputs(*program))
+{
+    m_interpreter.prepare();
+}
+
+bool BatchEvaluator::evaluate(const json::Document &doc)
+{
+    auto &mem = m_interpreter.memory_manager();
+    m_record.begin(mem);
+
+    bool result = false;
+
+    try
+    {
+        m_interpreter.set_document(m_input_name, doc, m_inputs);
+        result = m_interpreter.execute();
+    }
+    catch(...)
+    {
+        m_interpreter.reset();
+        m_record.release(mem);
+        throw;
+    }
+
+    m_interpreter.reset();
+    m_record.end(mem);
+
+    return result;
+}
+
+std::vector<bool> BatchEvaluator::evaluate(const json::Document *docs, size_t count)
+{
+    std::vector<bool> results(count);
+
+    for(size_t i = 0; i < count; ++i)
+        results[i] = evaluate(docs[i]);
+
+    return results;
+}
+
+std::vector<bool> BatchEvaluator::evaluate(const std::vector<json::Document> &docs)
+{
+    return evaluate(docs.data(), docs.size());
+}
+
+}
@@ -14,6 +14,7 @@ enum class BuiltinType
     Range,
     MakeInt,
     MakeString,
+    MakeSet,
     Print
 };
 
@@ -34,20 +35,45 @@ public:
         return ValueType::Builtin;
     }
 
+    BuiltinType builtin_type() const
+    {
+        return m_type;
+    }
+
     ValuePtr call(const std::vector<ValuePtr> &args) override
     {
         if(m_type == BuiltinType::Range)
         {
-            //TODO implemeent the rest...
-            if(args.size() != 1)
+            if(args.size() < 1 || args.size() > 3)
                 throw std::runtime_error("Invalid number of arguments");
 
-            auto arg = args[0];
+            int32_t bounds[3] = {0, 0, 0};
+
+            for(uint32_t i = 0; i < args.size(); ++i)
+            {
+                auto arg = args[i];
+
+                if(arg == nullptr || arg->type() != ValueType::Integer)
+                    throw std::runtime_error("invalid argument type");
+
+                bounds[i] = value_cast<IntVal>(arg)->get();
+            }
+
+            int32_t start = 0, end = bounds[0], step = 1;
+
+            if(args.size() > 1)
+            {
+                start = bounds[0];
+                end = bounds[1];
+            }
+
+            if(args.size() > 2)
+                step = bounds[2];
 
-            if(arg == nullptr || arg->type() != ValueType::Integer)
-                throw std::runtime_error("invalid argument type");
+            if(step == 0)
+                throw std::runtime_error("range() step must not be zero");
 
-            return ValuePtr(new (memory_manager()) RangeIterator(memory_manager(), 0, value_cast<IntVal>(arg)->get(), 1));
+            return ValuePtr(new (memory_manager()) RangeIterator(memory_manager(), start, end, step));
         }
         else if(m_type == BuiltinType::MakeString)
         {
@@ -88,6 +114,35 @@ public:
             else
                 throw std::runtime_error("Can't conver to integer");
         }
+        else if(m_type == BuiltinType::MakeSet)
+        {
+            if(args.size() > 1)
+                throw std::runtime_error("Invalid number of arguments");
+
+            auto res = memory_manager().create_set();
+
+            if(args.empty())
+                return res;
+
+            auto arg = args[0];
+            IteratorPtr iter = nullptr;
+
+            if(arg && arg->is_generator())
+                iter = value_cast<Iterator>(arg);
+            else if(arg && arg->can_iterate())
+                iter = value_cast<IterateableValue>(arg)->iterate();
+            else
+                throw std::runtime_error("Can't iterate");
+
+            ValuePtr elem = nullptr;
+
+            while(iter->next(elem))
+            {
+                res->insert(elem);
+            }
+
+            return res;
+        }
         else if(m_type == BuiltinType::Print)
         {
             if(args.size() != 1)
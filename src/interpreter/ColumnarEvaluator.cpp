@@ -0,0 +1,829 @@
+#include <algorithm>
+#include <iterator>
+
+#include "chipy/ColumnarEvaluator.h"
+#include "chipy/Dictionary.h"
+#include "Operators.h"
+#include "SyntaxTree.h"
+
+#if defined(__SSE2__) && !defined(IS_ENCLAVE)
+#include <emmintrin.h>
+#define CHIPY_COLUMN_SIMD
+#endif
+
+namespace chipy
+{
+
+ColumnBatch::ColumnBatch(size_t num_rows)
+    : m_num_rows(num_rows)
+{
+}
+
+Column& ColumnBatch::add_column(const InputPath &path, ColumnType type, size_t size)
+{
+    if(path.empty())
+        throw std::runtime_error("Column path is empty");
+
+    if(size != m_num_rows)
+        throw std::runtime_error("Column size does not match the batch");
+
+    auto &column = m_columns[path];
+    column = Column();
+    column.type = type;
+    return column;
+}
+
+void ColumnBatch::add_int_column(const InputPath &path, const std::vector<int32_t> &values)
+{
+    add_column(path, ColumnType::Integer, values.size()).integers = values;
+}
+
+void ColumnBatch::add_float_column(const InputPath &path, const std::vector<double> &values)
+{
+    add_column(path, ColumnType::Float, values.size()).floats = values;
+}
+
+void ColumnBatch::add_string_column(const InputPath &path, const std::vector<std::string> &dictionary, const std::vector<uint32_t> &codes)
+{
+    for(auto code: codes)
+    {
+        if(code >= dictionary.size())
+            throw std::runtime_error("String code out of range");
+    }
+
+    auto &column = add_column(path, ColumnType::String, codes.size());
+    column.dictionary = dictionary;
+    column.codes = codes;
+}
+
+const Column* ColumnBatch::find(const InputPath &path) const
+{
+    auto it = m_columns.find(path);
+
+    if(it == m_columns.end())
+        return nullptr;
+
+    return &it->second;
+}
+
+// Sorted indices of the rows that are still in play
+typedef std::vector<uint32_t> Selection;
+
+struct EqualOp
+{
+    template<typename T>
+    static bool test(T a, T b) { return a == b; }
+
+#ifdef CHIPY_COLUMN_SIMD
+    static int mask(__m128i a, __m128i b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, b))); }
+    static int mask(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpeq_pd(a, b)); }
+#endif
+};
+
+struct NotEqualOp
+{
+    template<typename T>
+    static bool test(T a, T b) { return a != b; }
+
+#ifdef CHIPY_COLUMN_SIMD
+    static int mask(__m128i a, __m128i b) { return EqualOp::mask(a, b) ^ 0xF; }
+    static int mask(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpneq_pd(a, b)); }
+#endif
+};
+
+struct LessOp
+{
+    template<typename T>
+    static bool test(T a, T b) { return a < b; }
+
+#ifdef CHIPY_COLUMN_SIMD
+    static int mask(__m128i a, __m128i b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a, b))); }
+    static int mask(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmplt_pd(a, b)); }
+#endif
+};
+
+struct MoreOp
+{
+    template<typename T>
+    static bool test(T a, T b) { return a > b; }
+
+#ifdef CHIPY_COLUMN_SIMD
+    static int mask(__m128i a, __m128i b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b))); }
+    static int mask(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)); }
+#endif
+};
+
+// Negating the integer masks is fine, but not the float ones because of NaN
+struct LessEqualOp
+{
+    template<typename T>
+    static bool test(T a, T b) { return a <= b; }
+
+#ifdef CHIPY_COLUMN_SIMD
+    static int mask(__m128i a, __m128i b) { return MoreOp::mask(a, b) ^ 0xF; }
+    static int mask(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmple_pd(a, b)); }
+#endif
+};
+
+struct MoreEqualOp
+{
+    template<typename T>
+    static bool test(T a, T b) { return a >= b; }
+
+#ifdef CHIPY_COLUMN_SIMD
+    static int mask(__m128i a, __m128i b) { return LessOp::mask(a, b) ^ 0xF; }
+    static int mask(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpge_pd(a, b)); }
+#endif
+};
+
+#ifdef CHIPY_COLUMN_SIMD
+static inline __m128i load(const int32_t *values) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)); }
+static inline __m128i load(const uint32_t *values) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)); }
+static inline __m128d load(const double *values) { return _mm_loadu_pd(values); }
+
+static inline __m128i splat(int32_t value) { return _mm_set1_epi32(value); }
+static inline __m128i splat(uint32_t value) { return _mm_set1_epi32(static_cast<int32_t>(value)); }
+static inline __m128d splat(double value) { return _mm_set1_pd(value); }
+#endif
+
+// Appends the rows of in for which `values[row] op constant` holds to out
+template<typename Op, typename T>
+static void select_compare(const T *values, T constant, size_t num_rows, const Selection &in, Selection &out)
+{
+    if(in.size() != num_rows)
+    {
+        for(auto row: in)
+        {
+            if(Op::test(values[row], constant))
+                out.push_back(row);
+        }
+        return;
+    }
+
+    // All rows are selected, so the column can be scanned as a whole
+    uint32_t row = 0;
+
+#ifdef CHIPY_COLUMN_SIMD
+    const uint32_t lanes = 16 / sizeof(T);
+    auto c = splat(constant);
+
+    for(; row + lanes <= num_rows; row += lanes)
+    {
+        int mask = Op::mask(load(values + row), c);
+
+        while(mask)
+        {
+            out.push_back(row + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for(; row < num_rows; ++row)
+    {
+        if(Op::test(values[row], constant))
+            out.push_back(row);
+    }
+}
+
+enum class CompareKind
+{
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    More,
+    MoreEqual
+};
+
+template<typename T>
+static void select_compare(CompareKind kind, const T *values, T constant, size_t num_rows, const Selection &in, Selection &out)
+{
+    switch(kind)
+    {
+    case CompareKind::Equal:
+        select_compare<EqualOp>(values, constant, num_rows, in, out);
+        break;
+    case CompareKind::NotEqual:
+        select_compare<NotEqualOp>(values, constant, num_rows, in, out);
+        break;
+    case CompareKind::Less:
+        select_compare<LessOp>(values, constant, num_rows, in, out);
+        break;
+    case CompareKind::LessEqual:
+        select_compare<LessEqualOp>(values, constant, num_rows, in, out);
+        break;
+    case CompareKind::More:
+        select_compare<MoreOp>(values, constant, num_rows, in, out);
+        break;
+    case CompareKind::MoreEqual:
+        select_compare<MoreEqualOp>(values, constant, num_rows, in, out);
+        break;
+    }
+}
+
+class Predicate
+{
+public:
+    virtual ~Predicate() {}
+
+    // Appends the rows of in that pass to out, keeping them sorted
+    virtual void select(const Selection &in, Selection &out) const = 0;
+};
+
+typedef std::unique_ptr<Predicate> PredicatePtr;
+
+template<typename T>
+class ComparePredicate : public Predicate
+{
+public:
+    ComparePredicate(const std::vector<T> &values, CompareKind kind, T constant)
+        : m_values(values), m_kind(kind), m_constant(constant)
+    {}
+
+    void select(const Selection &in, Selection &out) const override
+    {
+        select_compare(m_kind, m_values.data(), m_constant, m_values.size(), in, out);
+    }
+
+private:
+    const std::vector<T> &m_values;
+    const CompareKind m_kind;
+    const T m_constant;
+};
+
+class IntSetPredicate : public Predicate
+{
+public:
+    IntSetPredicate(const std::vector<int32_t> &values, std::vector<int32_t> constants, bool negate)
+        : m_values(values), m_constants(std::move(constants)), m_negate(negate)
+    {
+        std::sort(m_constants.begin(), m_constants.end());
+    }
+
+    void select(const Selection &in, Selection &out) const override
+    {
+        for(auto row: in)
+        {
+            if(std::binary_search(m_constants.begin(), m_constants.end(), m_values[row]) != m_negate)
+                out.push_back(row);
+        }
+    }
+
+private:
+    const std::vector<int32_t> &m_values;
+    std::vector<int32_t> m_constants;
+    const bool m_negate;
+};
+
+// Any test on a dictionary encoded column is decided once per dictionary
+// entry; the rows then only need their code looked up
+class StringPredicate : public Predicate
+{
+public:
+    StringPredicate(const Column &column, std::vector<uint8_t> matches)
+        : m_codes(column.codes), m_matches(std::move(matches)), m_num_matches(0)
+    {
+        for(uint32_t code = 0; code < m_matches.size(); ++code)
+        {
+            if(m_matches[code])
+            {
+                m_num_matches += 1;
+                m_match = code;
+            }
+            else
+                m_mismatch = code;
+        }
+    }
+
+    void select(const Selection &in, Selection &out) const override
+    {
+        if(m_num_matches == 0)
+            return;
+
+        if(m_num_matches == m_matches.size())
+            out.insert(out.end(), in.begin(), in.end());
+        else if(m_num_matches == 1)
+            select_compare<EqualOp>(m_codes.data(), m_match, m_codes.size(), in, out);
+        else if(m_num_matches + 1 == m_matches.size())
+            select_compare<NotEqualOp>(m_codes.data(), m_mismatch, m_codes.size(), in, out);
+        else
+        {
+            for(auto row: in)
+            {
+                if(m_matches[m_codes[row]])
+                    out.push_back(row);
+            }
+        }
+    }
+
+private:
+    const std::vector<uint32_t> &m_codes;
+    const std::vector<uint8_t> m_matches;
+
+    size_t m_num_matches;
+    uint32_t m_match = 0;
+    uint32_t m_mismatch = 0;
+};
+
+class NotPredicate : public Predicate
+{
+public:
+    NotPredicate(PredicatePtr operand)
+        : m_operand(std::move(operand))
+    {}
+
+    void select(const Selection &in, Selection &out) const override
+    {
+        Selection matches;
+        m_operand->select(in, matches);
+
+        std::set_difference(in.begin(), in.end(), matches.begin(), matches.end(), std::back_inserter(out));
+    }
+
+private:
+    PredicatePtr m_operand;
+};
+
+class AndPredicate : public Predicate
+{
+public:
+    AndPredicate(std::vector<PredicatePtr> operands)
+        : m_operands(std::move(operands))
+    {}
+
+    void select(const Selection &in, Selection &out) const override
+    {
+        // Every operand only looks at the rows that passed the previous ones
+        Selection current = in;
+        Selection next;
+
+        for(auto &operand: m_operands)
+        {
+            next.clear();
+            operand->select(current, next);
+            current.swap(next);
+
+            if(current.empty())
+                break;
+        }
+
+        out.insert(out.end(), current.begin(), current.end());
+    }
+
+private:
+    std::vector<PredicatePtr> m_operands;
+};
+
+class OrPredicate : public Predicate
+{
+public:
+    OrPredicate(std::vector<PredicatePtr> operands)
+        : m_operands(std::move(operands))
+    {}
+
+    void select(const Selection &in, Selection &out) const override
+    {
+        // Every operand only looks at the rows that are not decided yet
+        Selection remaining = in;
+        Selection result;
+        Selection matches, merged, rest;
+
+        for(auto &operand: m_operands)
+        {
+            matches.clear();
+            operand->select(remaining, matches);
+
+            if(matches.empty())
+                continue;
+
+            merged.clear();
+            std::merge(result.begin(), result.end(), matches.begin(), matches.end(), std::back_inserter(merged));
+            result.swap(merged);
+
+            rest.clear();
+            std::set_difference(remaining.begin(), remaining.end(), matches.begin(), matches.end(), std::back_inserter(rest));
+            remaining.swap(rest);
+
+            if(remaining.empty())
+                break;
+        }
+
+        out.insert(out.end(), result.begin(), result.end());
+    }
+
+private:
+    std::vector<PredicatePtr> m_operands;
+};
+
+class Planner
+{
+public:
+    Planner(const ColumnBatch &batch)
+        : m_batch(batch)
+    {}
+
+    // nullptr if node cannot be evaluated on columns
+    PredicatePtr plan(const Node &node) const
+    {
+        switch(node.type)
+        {
+        case NodeType::Compare:
+            return plan_compare(node);
+        case NodeType::UnaryOp:
+        {
+            if(static_cast<UnaryOpType>(node.op) != UnaryOpType::Not)
+                return nullptr;
+
+            auto operand = plan(*node.children[0]);
+            if(!operand)
+                return nullptr;
+
+            return PredicatePtr(new NotPredicate(std::move(operand)));
+        }
+        case NodeType::BoolOp:
+        {
+            std::vector<PredicatePtr> operands;
+
+            if(plan_prefix(node, operands) != node.children.size())
+                return nullptr;
+
+            if(static_cast<BoolOpType>(node.op) == BoolOpType::And)
+                return PredicatePtr(new AndPredicate(std::move(operands)));
+            else
+                return PredicatePtr(new OrPredicate(std::move(operands)));
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    // Plans the operands of a BoolOp up to the first unsupported one
+    // Returns how many were planned
+    size_t plan_prefix(const Node &node, std::vector<PredicatePtr> &operands) const
+    {
+        auto type = static_cast<BoolOpType>(node.op);
+
+        if(type != BoolOpType::And && type != BoolOpType::Or)
+            return 0;
+
+        for(auto &child: node.children)
+        {
+            auto operand = plan(*child);
+            if(!operand)
+                break;
+
+            operands.push_back(std::move(operand));
+        }
+
+        return operands.size();
+    }
+
+private:
+    const Column* find_column(const Node &node) const
+    {
+        InputPath path;
+
+        if(!column_path(node, path))
+            return nullptr;
+
+        return m_batch.find(path);
+    }
+
+    bool column_path(const Node &node, InputPath &path) const
+    {
+        if(node.type == NodeType::Name)
+        {
+            path.push_back(node.name);
+            return true;
+        }
+
+        if(node.type != NodeType::Subscript)
+            return false;
+
+        auto &slice = *node.children[0];
+
+        if(slice.type != NodeType::Index || slice.children[0]->type != NodeType::String)
+            return false;
+
+        if(!column_path(*node.children[1], path))
+            return false;
+
+        path.push_back(slice.children[0]->name);
+        return true;
+    }
+
+    PredicatePtr plan_compare(const Node &node) const
+    {
+        // Chains are not evaluated like in Python by the interpreter
+        if(node.ops.size() != 1)
+            return nullptr;
+
+        auto op = static_cast<CompareOpType>(node.ops[0]);
+        auto &left = *node.children[0];
+        auto &right = *node.children[1];
+
+        if(op == CompareOpType::In || op == CompareOpType::NotIn)
+        {
+            auto column = find_column(left);
+            if(!column)
+                return nullptr;
+
+            return plan_membership(*column, right, op == CompareOpType::NotIn);
+        }
+
+        auto column = find_column(left);
+        auto constant = &right;
+
+        if(!column)
+        {
+            column = find_column(right);
+            constant = &left;
+
+            if(!column)
+                return nullptr;
+
+            // Move the column to the left
+            switch(op)
+            {
+            case CompareOpType::Less:
+                op = CompareOpType::More;
+                break;
+            case CompareOpType::LessEqual:
+                op = CompareOpType::MoreEqual;
+                break;
+            case CompareOpType::More:
+                op = CompareOpType::Less;
+                break;
+            case CompareOpType::MoreEqual:
+                op = CompareOpType::LessEqual;
+                break;
+            default:
+                break;
+            }
+        }
+
+        CompareKind kind;
+
+        switch(op)
+        {
+        case CompareOpType::Equals:
+            kind = CompareKind::Equal;
+            break;
+        case CompareOpType::NotEqual:
+            kind = CompareKind::NotEqual;
+            break;
+        case CompareOpType::Less:
+            kind = CompareKind::Less;
+            break;
+        case CompareOpType::LessEqual:
+            kind = CompareKind::LessEqual;
+            break;
+        case CompareOpType::More:
+            kind = CompareKind::More;
+            break;
+        case CompareOpType::MoreEqual:
+            kind = CompareKind::MoreEqual;
+            break;
+        default:
+            return nullptr;
+        }
+
+        // Anything else, e.g. comparing a string with an integer, is left to
+        // the interpreter so its semantics are kept
+        if(column->type == ColumnType::Integer && constant->type == NodeType::Integer)
+            return PredicatePtr(new ComparePredicate<int32_t>(column->integers, kind, constant->integer));
+
+        if(column->type == ColumnType::Float && constant->type == NodeType::Integer)
+            return PredicatePtr(new ComparePredicate<double>(column->floats, kind, constant->integer));
+
+        if(column->type == ColumnType::String && constant->type == NodeType::String
+           && (kind == CompareKind::Equal || kind == CompareKind::NotEqual))
+        {
+            std::vector<uint8_t> matches;
+
+            for(auto &str: column->dictionary)
+                matches.push_back((str == constant->name) == (kind == CompareKind::Equal));
+
+            return PredicatePtr(new StringPredicate(*column, std::move(matches)));
+        }
+
+        return nullptr;
+    }
+
+    PredicatePtr plan_membership(const Column &column, const Node &container, bool negate) const
+    {
+        std::vector<int32_t> integers;
+        std::vector<std::string> strings;
+
+        if(container.type == NodeType::ConstantSet)
+        {
+            integers = container.integers;
+            strings = container.strings;
+        }
+        else if(container.type == NodeType::List || container.type == NodeType::Tuple || container.type == NodeType::Set)
+        {
+            for(auto &elem: container.children)
+            {
+                if(elem->type == NodeType::Integer)
+                    integers.push_back(elem->integer);
+                else if(elem->type == NodeType::String)
+                    strings.push_back(elem->name);
+                else
+                    return nullptr;
+            }
+        }
+        else
+            return nullptr;
+
+        // Elements of the other type never compare equal, so they are ignored
+        if(column.type == ColumnType::Integer)
+            return PredicatePtr(new IntSetPredicate(column.integers, std::move(integers), negate));
+
+        if(column.type == ColumnType::String)
+        {
+            std::sort(strings.begin(), strings.end());
+
+            std::vector<uint8_t> matches;
+
+            for(auto &str: column.dictionary)
+                matches.push_back(std::binary_search(strings.begin(), strings.end(), str) != negate);
+
+            return PredicatePtr(new StringPredicate(column, std::move(matches)));
+        }
+
+        return nullptr;
+    }
+
+    const ColumnBatch &m_batch;
+};
+
+static DictionaryPtr child_dictionary(MemoryManager &mem, Dictionary &parent, const std::string &key)
+{
+    auto &elements = parent.elements();
+    auto it = elements.find(key);
+
+    if(it != elements.end() && it->second && it->second->type() == ValueType::Dictionary)
+        return value_cast<Dictionary>(it->second);
+
+    auto dict = mem.create_dictionary();
+    parent.insert(key, dict);
+    return dict;
+}
+
+static ValuePtr column_value(MemoryManager &mem, const Column &column, uint32_t row)
+{
+    switch(column.type)
+    {
+    case ColumnType::Integer:
+        return mem.create_integer(column.integers[row]);
+    case ColumnType::Float:
+        return mem.create_float(column.floats[row]);
+    case ColumnType::String:
+        return mem.create_string(&column.dictionary[column.codes[row]]);
+    default:
+        throw std::runtime_error("Unknown column type");
+    }
+}
+
+static NodePtr find_expression(const BitStream &program)
+{
+    auto node = decode_program(program);
+
+    if(node->type == NodeType::StatementList && node->children.size() == 1)
+        node = node->children[0];
+
+    if(node->type != NodeType::Return)
+        return nullptr;
+
+    return node->children[0];
+}
+
+ColumnarEvaluator::ColumnarEvaluator(const BitStream &program)
+    : m_expression(find_expression(program)), m_interpreter(program), m_inputs(analyze_inputs(program))
+{
+    m_interpreter.prepare();
+}
+
+bool ColumnarEvaluator::is_vectorized(const ColumnBatch &batch) const
+{
+    return m_expression && Planner(batch).plan(*m_expression) != nullptr;
+}
+
+bool ColumnarEvaluator::evaluate_row(const ColumnBatch &batch, uint32_t row)
+{
+    auto &mem = m_interpreter.memory_manager();
+    m_record.begin(mem);
+
+    bool result = false;
+
+    try
+    {
+        std::map<std::string, DictionaryPtr> roots;
+
+        for(auto &it: batch.columns())
+        {
+            auto &path = it.first;
+
+            if(!m_inputs.reads(path))
+                continue;
+
+            auto value = column_value(mem, it.second, row);
+
+            if(path.size() == 1)
+            {
+                m_interpreter.set_value(path[0], value);
+                continue;
+            }
+
+            auto &root = roots[path[0]];
+            if(!root)
+                root = mem.create_dictionary();
+
+            auto dict = root;
+            for(size_t i = 1; i+1 < path.size(); ++i)
+                dict = child_dictionary(mem, *dict, path[i]);
+
+            dict->insert(path.back(), value);
+        }
+
+        for(auto &it: roots)
+            m_interpreter.set_value(it.first, it.second);
+
+        result = m_interpreter.execute();
+    }
+    catch(...)
+    {
+        m_interpreter.reset();
+        m_record.release(mem);
+        throw;
+    }
+
+    m_interpreter.reset();
+    m_record.end(mem);
+
+    m_num_scalar_rows += 1;
+    return result;
+}
+
+std::vector<uint32_t> ColumnarEvaluator::select(const ColumnBatch &batch)
+{
+    Selection all(batch.num_rows());
+    for(uint32_t row = 0; row < all.size(); ++row)
+        all[row] = row;
+
+    Selection result;
+
+    // Rows the kernels could not decide
+    Selection undecided;
+
+    if(!m_expression)
+        undecided.swap(all);
+    else if(auto predicate = Planner(batch).plan(*m_expression))
+    {
+        predicate->select(all, result);
+        return result;
+    }
+    else if(m_expression->type == NodeType::BoolOp)
+    {
+        // The operands before the first unsupported one still narrow things
+        // down; they are evaluated first by the interpreter as well
+        std::vector<PredicatePtr> prefix;
+        Planner(batch).plan_prefix(*m_expression, prefix);
+
+        if(static_cast<BoolOpType>(m_expression->op) == BoolOpType::And)
+            AndPredicate(std::move(prefix)).select(all, undecided);
+        else
+        {
+            OrPredicate(std::move(prefix)).select(all, result);
+            std::set_difference(all.begin(), all.end(), result.begin(), result.end(), std::back_inserter(undecided));
+        }
+    }
+    else
+        undecided.swap(all);
+
+    Selection matches;
+
+    for(auto row: undecided)
+    {
+        if(evaluate_row(batch, row))
+            matches.push_back(row);
+    }
+
+    Selection merged;
+    std::merge(result.begin(), result.end(), matches.begin(), matches.end(), std::back_inserter(merged));
+
+    return merged;
+}
+
+std::vector<bool> ColumnarEvaluator::evaluate(const ColumnBatch &batch)
+{
+    std::vector<bool> results(batch.num_rows(), false);
+
+    for(auto row: select(batch))
+        results[row] = true;
+
+    return results;
+}
+
+}
@@ -0,0 +1,179 @@
+#include <algorithm>
+
+#include "chipy/DecisionCache.h"
+#include "ValueKey.h"
+
+namespace chipy
+{
+
+DecisionCache::DecisionCache(size_t max_entries, size_t num_shards)
+    : m_shard_capacity(std::max<size_t>(1, max_entries / std::max<size_t>(1, num_shards))),
+      m_num_shapes(0), m_hits(0), m_misses(0), m_cacheable(true)
+{
+    for(size_t i = 0; i < std::max<size_t>(1, num_shards); ++i)
+        m_shards.emplace_back(new Shard());
+
+    m_shapes.reserve(MAX_SHAPES);
+}
+
+DecisionCache::Shard& DecisionCache::shard(const std::string &key)
+{
+    return *m_shards[std::hash<std::string>()(key) % m_shards.size()];
+}
+
+bool DecisionCache::lookup(Interpreter &interpreter, bool &result)
+{
+    auto num_shapes = m_num_shapes.load(std::memory_order_acquire);
+
+    for(size_t i = 0; i < num_shapes; ++i)
+    {
+        auto &shape = m_shapes[i];
+
+        std::string key = std::to_string(i) + ':';
+        bool valid = true;
+
+        for(auto &path: shape)
+        {
+            ValuePtr value;
+
+            if(!interpreter.resolve(path, value) || !append_value_key(value, key))
+            {
+                valid = false;
+                break;
+            }
+        }
+
+        if(!valid)
+            continue;
+
+        auto &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto it = s.entries.find(key);
+        if(it == s.entries.end())
+            continue;
+
+        s.order.splice(s.order.begin(), s.order, it->second.position);
+        result = it->second.result;
+        return true;
+    }
+
+    return false;
+}
+
+void DecisionCache::store(Interpreter &interpreter, bool result)
+{
+    auto reads = interpreter.reads();
+
+    std::vector<InputPath> shape;
+    for(auto &read: reads)
+        shape.push_back(read.path);
+
+    size_t index = MAX_SHAPES;
+
+    {
+        std::lock_guard<std::mutex> lock(m_shapes_mutex);
+
+        auto num_shapes = m_num_shapes.load(std::memory_order_relaxed);
+
+        for(size_t i = 0; i < num_shapes; ++i)
+        {
+            if(m_shapes[i] == shape)
+                index = i;
+        }
+
+        if(index == MAX_SHAPES)
+        {
+            // Programs that read something else every time are not worth caching
+            if(num_shapes >= MAX_SHAPES)
+                return;
+
+            index = num_shapes;
+            m_shapes.push_back(shape);
+            m_num_shapes.store(num_shapes + 1, std::memory_order_release);
+        }
+    }
+
+    // The values as they were read, the program might have rebound the names since
+    std::string key = std::to_string(index) + ':';
+
+    for(auto &read: reads)
+    {
+        if(!append_value_key(read.value, key))
+        {
+            m_cacheable = false;
+            return;
+        }
+    }
+
+    auto &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto it = s.entries.find(key);
+    if(it != s.entries.end())
+        return;
+
+    if(s.entries.size() >= m_shard_capacity)
+    {
+        s.entries.erase(*s.order.back());
+        s.order.pop_back();
+    }
+
+    it = s.entries.emplace(key, Entry{result, s.order.end()}).first;
+    s.order.push_front(&it->first);
+    it->second.position = s.order.begin();
+}
+
+bool DecisionCache::execute(Interpreter &interpreter)
+{
+    if(!m_cacheable)
+    {
+        interpreter.set_read_tracking(false);
+        return interpreter.execute();
+    }
+
+    bool result = false;
+
+    if(lookup(interpreter, result))
+    {
+        m_hits += 1;
+        return result;
+    }
+
+    m_misses += 1;
+
+    interpreter.set_read_tracking(true);
+    result = interpreter.execute();
+
+    if(!interpreter.reads_complete())
+        m_cacheable = false;
+    else
+        store(interpreter, result);
+
+    return result;
+}
+
+size_t DecisionCache::size() const
+{
+    size_t result = 0;
+
+    for(auto &s: m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        result += s->entries.size();
+    }
+
+    return result;
+}
+
+void DecisionCache::clear()
+{
+    for(auto &s: m_shards)
+    {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->entries.clear();
+        s->order.clear();
+    }
+}
+
+}
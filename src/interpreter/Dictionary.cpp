@@ -9,15 +9,15 @@ DictItemIterator::DictItemIterator(MemoryManager &mem, Dictionary &dict)
 {
 }
 
-ValuePtr DictItemIterator::next() 
+bool DictItemIterator::next(ValuePtr &out)
 {
     if(m_it == m_dict.elements().end())
-        throw stop_iteration_exception();
+        return false;
 
-    auto key = wrap_value(new (memory_manager()) StringVal(memory_manager(), m_it->first));
-    auto t = wrap_value(new (memory_manager()) Tuple(memory_manager(), key, m_it->second));
+    auto key = m_dict.key_value(*m_it);
+    out = memory_manager().create_tuple(key, m_it->second);
     m_it++;
-    return t;
+    return true;
 }
 
 ValuePtr DictItemIterator::duplicate()
@@ -35,15 +35,15 @@ DictItemsPtr Dictionary::items()
     return wrap_value(new (memory_manager()) DictItems(memory_manager(), *this));
 }
 
-ValuePtr DictKeyIterator::next() 
+bool DictKeyIterator::next(ValuePtr &out)
 {
     if(m_it == m_dict.elements().end())
-        throw stop_iteration_exception();
+        return false;
 
     // FIXME implement tuples
-    auto &elem = m_it->second;
+    out = m_it->second;
     m_it++;
-    return elem;
+    return true;
 }
 
 ValuePtr DictKeyIterator::duplicate()
@@ -63,17 +63,30 @@ IteratorPtr DictItems::iterate()
 
 const std::map<std::string, ValuePtr>& Dictionary::elements() const
 {
+    // Loading does not change the logical contents
+    const_cast<Dictionary*>(this)->load_all();
     return m_elements;
 }
 
 std::map<std::string, ValuePtr>& Dictionary::elements()
 {
+    load_all();
     return m_elements;
 }
 
 uint32_t Dictionary::size() const
 {
-    return m_elements.size();
+    return elements().size();
+}
+
+ValuePtr Dictionary::load(const std::string &key)
+{
+    (void)key;
+    return nullptr;
+}
+
+void Dictionary::load_all()
+{
 }
 
 IteratorPtr Dictionary::iterate()
@@ -85,16 +98,32 @@ ValuePtr Dictionary::get(const std::string &key)
 {
     auto it = m_elements.find(key);
     if(it == m_elements.end())
-        return nullptr;
+        return load(key);
 
     return it->second;
 }
 
+StringValPtr Dictionary::key_value(const std::pair<const std::string, ValuePtr> &entry)
+{
+    auto &key = m_key_values[&entry.first];
+
+    // The entry might have replaced an erased one at the same address
+    if(!key || key->get() != entry.first)
+        key = memory_manager().create_string(entry.first);
+
+    return key;
+}
+
 void Dictionary::insert(const std::string &key, ValuePtr value)
 {
     m_elements[key] = value;
 }
 
+void Dictionary::insert(std::string &&key, ValuePtr value)
+{
+    m_elements[std::move(key)] = value;
+}
+
 ValueType Dictionary::type() const
 {
     return ValueType::Dictionary;
@@ -104,7 +133,7 @@ ValuePtr Dictionary::duplicate()
 {
     auto d = wrap_value(new (memory_manager()) Dictionary(memory_manager()));
 
-    for(auto &it: m_elements)
+    for(auto &it: elements())
     {
         d->insert(it.first, it.second);
     }
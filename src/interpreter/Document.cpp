@@ -1,66 +1,314 @@
+#include <cmath>
+#include <vector>
+
 #include "chipy/Value.h"
 #include "chipy/Dictionary.h"
 #include "chipy/List.h"
+#include "chipy/Set.h"
+#include "chipy/Tuple.h"
+#include "Number.h"
 
 namespace chipy
 {
 
-void value_to_bdoc(const std::string &key, ValuePtr value, json::Writer &writer)
+// Writes JSON text into a caller-owned buffer
+// Has the same interface as json::Writer so both can drive the serializer
+class JsonTextWriter
 {
-    switch(value->type())
+public:
+    JsonTextWriter(std::string &out)
+        : m_out(out)
+    {}
+
+    void start_map(const std::string &key)
     {
-    case ValueType::Dictionary:
+        write_key(key);
+        m_out += '{';
+        m_first.push_back(true);
+        m_in_map.push_back(true);
+    }
+
+    void end_map()
     {
-        auto dict = value_cast<Dictionary>(value);
-        writer.start_map(key);
+        m_out += '}';
+        m_first.pop_back();
+        m_in_map.pop_back();
+    }
 
-        for(auto &e : dict->elements())
-        {
-            auto &key = e.first;
-            auto &value = e.second;
+    void start_array(const std::string &key)
+    {
+        write_key(key);
+        m_out += '[';
+        m_first.push_back(true);
+        m_in_map.push_back(false);
+    }
 
-            value_to_bdoc(key, value, writer);
-        }
+    void end_array()
+    {
+        m_out += ']';
+        m_first.pop_back();
+        m_in_map.pop_back();
+    }
 
-        writer.end_map();
-        break;
+    void write_string(const std::string &key, const std::string &str)
+    {
+        write_key(key);
+        write_quoted(str);
+    }
+
+    void write_integer(const std::string &key, int64_t i)
+    {
+        write_key(key);
+        m_out += std::to_string(i);
     }
-    case ValueType::List:
+
+    void write_float(const std::string &key, double f)
     {
-        auto l = value_cast<List>(value);
-        writer.start_array(key);
+        if(std::isnan(f) || std::isinf(f))
+            throw std::runtime_error("Cannot write non-finite float as JSON");
+
+        write_key(key);
+
+        // Prefer the shorter form, e.g. 0.1 rather than 0.10000000000000001
+        auto start = m_out.size();
+        append_float(f, m_out);
+
+        // Keep floats distinguishable from integers
+        if(m_out.find_first_of(".e", start) == std::string::npos)
+            m_out += ".0";
+    }
 
-        for(auto &e : l->elements())
+    void write_boolean(const std::string &key, bool b)
+    {
+        write_key(key);
+        m_out += b ? "true" : "false";
+    }
+
+    void write_null(const std::string &key)
+    {
+        write_key(key);
+        m_out += "null";
+    }
+
+private:
+    void write_key(const std::string &key)
+    {
+        if(m_first.empty())
+            return;
+
+        if(!m_first.back())
+            m_out += ',';
+        m_first.back() = false;
+
+        if(m_in_map.back())
         {
-            value_to_bdoc("", e, writer);
+            write_quoted(key);
+            m_out += ':';
+        }
+    }
+
+    void write_quoted(const std::string &str)
+    {
+        static const char *hex = "0123456789abcdef";
+
+        m_out += '"';
+
+        size_t start = 0;
+        for(size_t i = 0; i < str.size(); ++i)
+        {
+            auto c = static_cast<unsigned char>(str[i]);
+
+            if(c >= 0x20 && c != '"' && c != '\\')
+                continue;
+
+            m_out.append(str, start, i - start);
+            start = i+1;
+
+            switch(c)
+            {
+            case '"':
+                m_out += "\\\"";
+                break;
+            case '\\':
+                m_out += "\\\\";
+                break;
+            case '\n':
+                m_out += "\\n";
+                break;
+            case '\r':
+                m_out += "\\r";
+                break;
+            case '\t':
+                m_out += "\\t";
+                break;
+            default:
+                m_out += "\\u00";
+                m_out += hex[c >> 4];
+                m_out += hex[c & 0xF];
+            }
         }
 
-        writer.end_map();
-        break;
+        m_out.append(str, start, std::string::npos);
+        m_out += '"';
     }
-    case ValueType::String:
+
+    std::string &m_out;
+
+    std::vector<bool> m_first;
+    std::vector<bool> m_in_map;
+};
+
+// Walks a value with an explicit stack, so deeply nested values do not recurse
+template<typename Writer>
+class ValueSerializer
+{
+public:
+    ValueSerializer(Writer &writer)
+        : m_writer(writer)
+    {}
+
+    void run(const ValuePtr &value)
     {
-        auto str = value_cast<StringVal>(value);
-        writer.write_string(key, str->get());
-        break;
+        static const std::string empty_key = "";
+
+        write_value(empty_key, value);
+
+        while(!m_stack.empty())
+        {
+            auto &frame = m_stack.back();
+
+            if(frame.type == ValueType::Dictionary)
+            {
+                if(frame.it == frame.end)
+                {
+                    m_writer.end_map();
+                    m_stack.pop_back();
+                    continue;
+                }
+
+                auto &entry = *frame.it;
+                ++frame.it;
+
+                // May push a frame and invalidate the reference
+                write_value(entry.first, entry.second);
+            }
+            else
+            {
+                if(frame.index == frame.size)
+                {
+                    m_writer.end_array();
+                    m_stack.pop_back();
+                    continue;
+                }
+
+                auto elem = element(frame);
+                frame.index += 1;
+
+                write_value(empty_key, elem);
+            }
+        }
     }
-    case ValueType::Integer:
+
+private:
+    struct Frame
     {
-        auto i = value_cast<IntVal>(value);
-        writer.write_integer(key, i->get());
-        break;
+        ValuePtr value;
+        ValueType type;
+
+        std::map<std::string, ValuePtr>::const_iterator it, end;
+        uint32_t index;
+        uint32_t size;
+    };
+
+    ValuePtr element(const Frame &frame)
+    {
+        switch(frame.type)
+        {
+        case ValueType::List:
+            return value_cast<List>(frame.value)->get(frame.index);
+        case ValueType::Tuple:
+            return value_cast<Tuple>(frame.value)->get(frame.index);
+        default:
+            return value_cast<Set>(frame.value)->elements()[frame.index];
+        }
     }
-    default:
-        throw std::runtime_error("Unknown value type");
+
+    void write_value(const std::string &key, const ValuePtr &value)
+    {
+        if(!value)
+        {
+            m_writer.write_null(key);
+            return;
+        }
+
+        Frame frame;
+        frame.value = value;
+        frame.type = value->type();
+        frame.index = 0;
+        frame.size = 0;
+
+        switch(frame.type)
+        {
+        case ValueType::Bool:
+            m_writer.write_boolean(key, value_cast<BoolVal>(value)->get());
+            return;
+        case ValueType::String:
+            m_writer.write_string(key, value_cast<StringVal>(value)->get());
+            return;
+        case ValueType::Integer:
+            m_writer.write_integer(key, value_cast<IntVal>(value)->get());
+            return;
+        case ValueType::Float:
+            m_writer.write_float(key, value_cast<FloatVal>(value)->get());
+            return;
+        case ValueType::Dictionary:
+        {
+            auto &elements = value_cast<Dictionary>(value)->elements();
+            frame.it = elements.begin();
+            frame.end = elements.end();
+            m_writer.start_map(key);
+            break;
+        }
+        case ValueType::List:
+            frame.size = value_cast<List>(value)->size();
+            m_writer.start_array(key);
+            break;
+        case ValueType::Tuple:
+            frame.size = value_cast<Tuple>(value)->size();
+            m_writer.start_array(key);
+            break;
+        case ValueType::Set:
+            // Sets have no document equivalent and are written as arrays
+            frame.size = value_cast<Set>(value)->elements().size();
+            m_writer.start_array(key);
+            break;
+        default:
+            throw std::runtime_error("Cannot serialize value of this type");
+        }
+
+        m_stack.push_back(frame);
     }
-}
+
+    Writer &m_writer;
+    std::vector<Frame> m_stack;
+};
 
 json::Document value_to_document(ValuePtr value)
 {
     json::Writer writer;
-    value_to_bdoc("", value, writer);
+
+    ValueSerializer<json::Writer> serializer(writer);
+    serializer.run(value);
 
     return writer.make_document();
 }
 
+void value_to_json(const ValuePtr &value, std::string &out)
+{
+    JsonTextWriter writer(out);
+
+    ValueSerializer<JsonTextWriter> serializer(writer);
+    serializer.run(value);
+}
+
 }
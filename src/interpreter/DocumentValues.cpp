@@ -0,0 +1,268 @@
+#include <functional>
+#include <memory>
+
+#include "DocumentValues.h"
+#include "DocConverter.h"
+
+namespace chipy
+{
+
+// Converts the direct children of a map or array
+// Nested containers are wrapped in views instead of being converted, unless
+// their key cannot be expressed as a document path
+class ChildLoader : public json::Iterator
+{
+public:
+    typedef std::function<void(const std::string&, ValuePtr)> sink_t;
+
+    ChildLoader(MemoryManager &mem, const json::Document &doc, sink_t sink)
+        : m_mem(mem), m_doc(doc), m_sink(sink)
+    {}
+
+    void handle_datetime(const std::string &key, const tm &value) override
+    {
+        (void)key;
+        (void)value;
+        throw std::runtime_error("Datetime not supported");
+    }
+
+    void handle_string(const std::string &key, const std::string &str) override
+    {
+        if(m_converter)
+            m_converter->handle_string(key, str);
+        else
+            add_child(key, m_mem.create_string(str));
+    }
+
+    void handle_integer(const std::string &key, int64_t i) override
+    {
+        if(m_converter)
+            m_converter->handle_integer(key, i);
+        else
+            add_child(key, m_mem.create_integer(i));
+    }
+
+    void handle_float(const std::string &key, const double value) override
+    {
+        if(m_converter)
+            m_converter->handle_float(key, value);
+        else
+            add_child(key, m_mem.create_float(value));
+    }
+
+    void handle_boolean(const std::string &key, const bool value) override
+    {
+        if(m_converter)
+            m_converter->handle_boolean(key, value);
+        else
+            add_child(key, m_mem.create_boolean(value));
+    }
+
+    void handle_null(const std::string &key) override
+    {
+        if(m_converter)
+            m_converter->handle_null(key);
+        else
+            add_child(key, m_mem.create_none());
+    }
+
+    void handle_map_start(const std::string &key) override
+    {
+        start_container(key, true);
+    }
+
+    void handle_map_end() override
+    {
+        end_container(true);
+    }
+
+    void handle_array_start(const std::string &key) override
+    {
+        start_container(key, false);
+    }
+
+    void handle_array_end() override
+    {
+        end_container(false);
+    }
+
+    void handle_binary(const std::string &key, const uint8_t *data, uint32_t len) override
+    {
+        //FIXME
+        (void)key;
+        (void)data;
+        (void)len;
+    }
+
+private:
+    void start_container(const std::string &key, bool is_map)
+    {
+        m_depth += 1;
+
+        if(m_depth == 1)
+        {
+            m_is_array = !is_map;
+            return;
+        }
+
+        if(m_depth == 2)
+        {
+            m_key = child_path(key);
+
+            if(m_key.find('.') == std::string::npos)
+            {
+                add_child(key, m_mem.create_document_view(json::Document(m_doc, m_key, false)));
+                m_skip = true;
+                return;
+            }
+
+            m_converter.reset(new DocConverter(m_mem));
+            m_key = key;
+
+            if(is_map)
+                m_converter->handle_map_start("");
+            else
+                m_converter->handle_array_start("");
+            return;
+        }
+
+        if(m_converter)
+        {
+            if(is_map)
+                m_converter->handle_map_start(key);
+            else
+                m_converter->handle_array_start(key);
+        }
+    }
+
+    void end_container(bool is_map)
+    {
+        m_depth -= 1;
+
+        if(m_depth == 1)
+        {
+            if(m_converter)
+            {
+                auto value = m_converter->get_result();
+                m_converter.reset();
+                add_child(m_key, value);
+            }
+
+            m_skip = false;
+            return;
+        }
+
+        if(m_converter)
+        {
+            if(is_map)
+                m_converter->handle_map_end();
+            else
+                m_converter->handle_array_end();
+        }
+    }
+
+    std::string child_path(const std::string &key)
+    {
+        if(m_is_array)
+            return std::to_string(m_index);
+        else
+            return key;
+    }
+
+    void add_child(const std::string &key, ValuePtr value)
+    {
+        // Contents of a nested view are not needed
+        if(m_skip)
+            return;
+
+        m_sink(key, value);
+        m_index += 1;
+    }
+
+    MemoryManager &m_mem;
+    const json::Document &m_doc;
+    sink_t m_sink;
+
+    uint32_t m_depth = 0;
+    uint32_t m_index = 0;
+    bool m_is_array = false;
+    bool m_skip = false;
+
+    std::string m_key;
+    std::unique_ptr<DocConverter> m_converter;
+};
+
+ValuePtr DocumentDictionary::load(const std::string &key)
+{
+    if(m_loaded)
+        return nullptr;
+
+    // Keys with dots cannot be expressed as a path
+    if(key.find('.') != std::string::npos)
+    {
+        load_all();
+
+        auto it = m_elements.find(key);
+        if(it == m_elements.end())
+            return nullptr;
+
+        return it->second;
+    }
+
+    json::Document child(m_doc, key, false);
+
+    if(child.empty())
+        return nullptr;
+
+    auto value = memory_manager().create_document_view(child);
+    m_elements[key] = value;
+    return value;
+}
+
+void DocumentDictionary::load_all()
+{
+    if(m_loaded)
+        return;
+
+    m_loaded = true;
+
+    ChildLoader loader(memory_manager(), m_doc,
+            [&](const std::string &key, ValuePtr value) {
+        // Keep entries that were already looked up
+        m_elements.emplace(key, value);
+    });
+
+    m_doc.iterate(loader);
+}
+
+void DocumentList::load_all()
+{
+    if(m_loaded)
+        return;
+
+    m_loaded = true;
+
+    ChildLoader loader(memory_manager(), m_doc,
+            [&](const std::string &key, ValuePtr value) {
+        (void)key;
+        m_elements.push_back(value);
+    });
+
+    m_doc.iterate(loader);
+}
+
+ValuePtr MemoryManager::create_document_view(const json::Document &doc)
+{
+    switch(doc.get_type())
+    {
+    case json::ObjectType::Map:
+        return wrap_value(new (*this) DocumentDictionary(*this, doc));
+    case json::ObjectType::Array:
+        return wrap_value(new (*this) DocumentList(*this, doc));
+    default:
+        // Scalars are cheap enough to convert right away
+        return create_from_document(doc);
+    }
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "chipy/Dictionary.h"
+#include "chipy/List.h"
+
+namespace chipy
+{
+
+// Dictionary backed by a json::Document
+// Entries are converted when they are first looked up or iterated; nested maps
+// and arrays become views themselves, so untouched parts are never converted
+class DocumentDictionary : public Dictionary
+{
+public:
+    DocumentDictionary(MemoryManager &mem, const json::Document &doc)
+        : Dictionary(mem), m_doc(doc)
+    {}
+
+protected:
+    ValuePtr load(const std::string &key) override;
+    void load_all() override;
+
+private:
+    const json::Document m_doc;
+    bool m_loaded = false;
+};
+
+// List backed by a json::Document
+// All elements are loaded on first access, but nested containers stay lazy
+class DocumentList : public List
+{
+public:
+    DocumentList(MemoryManager &mem, const json::Document &doc)
+        : List(mem), m_doc(doc)
+    {}
+
+protected:
+    void load_all() override;
+
+private:
+    const json::Document m_doc;
+    bool m_loaded = false;
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "chipy/List.h"
+
+namespace chipy
+{
+
+// List of strings owned by the host
+// Binding it is constant time; the elements are created on first access and
+// refer to the host's strings rather than copying them
+class ExternalList : public List
+{
+public:
+    // strings must outlive the list and all values taken from it
+    ExternalList(MemoryManager &mem, const std::vector<std::string> *strings)
+        : List(mem), m_strings(strings)
+    {}
+
+    ExternalList(MemoryManager &mem, const std::shared_ptr<const std::vector<std::string>> &strings)
+        : List(mem), m_strings(strings.get()), m_shared(strings)
+    {}
+
+protected:
+    void load_all() override
+    {
+        if(m_loaded)
+            return;
+
+        m_loaded = true;
+        m_elements.reserve(m_strings->size());
+
+        for(auto &str: *m_strings)
+        {
+            if(m_shared)
+            {
+                // Every element keeps the whole vector alive
+                std::shared_ptr<const std::string> ptr(m_shared, &str);
+                m_elements.push_back(memory_manager().create_string(ptr));
+            }
+            else
+                m_elements.push_back(memory_manager().create_string(&str));
+        }
+    }
+
+private:
+    const std::vector<std::string> *m_strings;
+    std::shared_ptr<const std::vector<std::string>> m_shared;
+    bool m_loaded = false;
+};
+
+}
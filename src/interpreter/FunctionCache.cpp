@@ -0,0 +1,338 @@
+#include <algorithm>
+
+#include "chipy/FunctionCache.h"
+#include "chipy/Dictionary.h"
+#include "chipy/List.h"
+#include "chipy/Set.h"
+#include "chipy/Tuple.h"
+#include "ValueKey.h"
+
+namespace chipy
+{
+
+// A copy of a result that does not belong to any MemoryManager
+struct FunctionCache::StoredValue
+{
+    bool is_none;
+    ValueType type;
+
+    bool boolean;
+    int32_t integer;
+    double number;
+    std::string string;
+
+    // Keys of dictionaries, in the same order as elements
+    std::vector<std::string> keys;
+    std::vector<StoredValue> elements;
+};
+
+class PureFunction : public Callable
+{
+public:
+    PureFunction(MemoryManager &mem, FunctionCache &cache, FunctionCache::Function &function, const ValuePtr &callable)
+        : Callable(mem), m_cache(cache), m_function(function), m_callable(callable)
+    {}
+
+    ValueType type() const override { return ValueType::Function; }
+
+    ValuePtr duplicate() override
+    {
+        return wrap_value(new (memory_manager()) PureFunction(memory_manager(), m_cache, m_function, m_callable));
+    }
+
+    ValuePtr call(const std::vector<ValuePtr> &args) override
+    {
+        return invoke(args.data(), args.size());
+    }
+
+    ValuePtr invoke(const ValuePtr *args, uint32_t num_args) override
+    {
+        return m_cache.invoke(m_function, *value_cast<Callable>(m_callable), memory_manager(), args, num_args);
+    }
+
+    bool is_pure() const override
+    {
+        return true;
+    }
+
+    void count_reused_result() override
+    {
+        m_function.calls += 1;
+        m_function.execution_hits += 1;
+    }
+
+private:
+    FunctionCache &m_cache;
+    FunctionCache::Function &m_function;
+    ValuePtr m_callable;
+};
+
+bool FunctionCache::store_value(const ValuePtr &value, StoredValue &stored)
+{
+    stored.is_none = !value;
+
+    if(!value)
+        return true;
+
+    stored.type = value->type();
+
+    switch(stored.type)
+    {
+    case ValueType::Bool:
+        stored.boolean = value_cast<BoolVal>(value)->get();
+        return true;
+    case ValueType::Integer:
+        stored.integer = value_cast<IntVal>(value)->get();
+        return true;
+    case ValueType::Float:
+        stored.number = value_cast<FloatVal>(value)->get();
+        return true;
+    case ValueType::String:
+        stored.string = value_cast<StringVal>(value)->get();
+        return true;
+    case ValueType::List:
+    case ValueType::Set:
+    {
+        auto &elements = stored.type == ValueType::List ? value_cast<List>(value)->elements()
+                                                        : value_cast<Set>(value)->elements();
+
+        stored.elements.resize(elements.size());
+
+        for(size_t i = 0; i < elements.size(); ++i)
+        {
+            if(!store_value(elements[i], stored.elements[i]))
+                return false;
+        }
+        return true;
+    }
+    case ValueType::Tuple:
+    {
+        auto tuple = value_cast<Tuple>(value);
+        stored.elements.resize(tuple->size());
+
+        for(uint32_t i = 0; i < tuple->size(); ++i)
+        {
+            if(!store_value(tuple->get(i), stored.elements[i]))
+                return false;
+        }
+        return true;
+    }
+    case ValueType::Dictionary:
+    {
+        auto &elements = value_cast<Dictionary>(value)->elements();
+        stored.elements.resize(elements.size());
+
+        size_t i = 0;
+        for(auto &it: elements)
+        {
+            stored.keys.push_back(it.first);
+
+            if(!store_value(it.second, stored.elements[i]))
+                return false;
+
+            i += 1;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Results are rebuilt for every call, so the program can modify them
+ValuePtr FunctionCache::load_value(MemoryManager &mem, const StoredValue &stored)
+{
+    if(stored.is_none)
+        return mem.create_none();
+
+    switch(stored.type)
+    {
+    case ValueType::Bool:
+        return mem.create_boolean(stored.boolean);
+    case ValueType::Integer:
+        return mem.create_integer(stored.integer);
+    case ValueType::Float:
+        return mem.create_float(stored.number);
+    case ValueType::String:
+        return mem.create_string(stored.string);
+    case ValueType::List:
+    {
+        auto list = mem.create_list();
+
+        for(auto &elem: stored.elements)
+            list->append(load_value(mem, elem));
+
+        return list;
+    }
+    case ValueType::Set:
+    {
+        auto set = mem.create_set();
+
+        for(auto &elem: stored.elements)
+            set->insert(load_value(mem, elem));
+
+        return set;
+    }
+    case ValueType::Tuple:
+    {
+        auto tuple = mem.create_tuple(stored.elements.size());
+
+        for(size_t i = 0; i < stored.elements.size(); ++i)
+            tuple->set(i, load_value(mem, stored.elements[i]));
+
+        return tuple;
+    }
+    case ValueType::Dictionary:
+    {
+        auto dict = mem.create_dictionary();
+
+        for(size_t i = 0; i < stored.elements.size(); ++i)
+            dict->insert(stored.keys[i], load_value(mem, stored.elements[i]));
+
+        return dict;
+    }
+    default:
+        throw std::runtime_error("Invalid stored value");
+    }
+}
+
+FunctionCache::FunctionCache(size_t max_entries)
+    : m_max_entries(std::max<size_t>(1, max_entries))
+{}
+
+ValuePtr FunctionCache::make_pure(MemoryManager &mem, const std::string &name, const ValuePtr &function, clock::duration ttl)
+{
+    if(!function || !function->is_callable())
+        throw std::runtime_error("Not a function: " + name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_function_names.find(name);
+
+    if(it == m_function_names.end())
+    {
+        m_functions.emplace_back(new Function());
+
+        auto &f = *m_functions.back();
+        f.id = m_functions.size() - 1;
+        f.name = name;
+        f.ttl = ttl;
+        f.calls = 0;
+        f.execution_hits = 0;
+        f.shared_hits = 0;
+
+        it = m_function_names.emplace(name, &f).first;
+    }
+    else if(it->second->ttl != ttl)
+        throw std::runtime_error("Function registered with a different TTL: " + name);
+
+    return wrap_value(new (mem) PureFunction(mem, *this, *it->second, function));
+}
+
+ValuePtr FunctionCache::invoke(Function &function, Callable &callable, MemoryManager &mem, const ValuePtr *args, uint32_t num_args)
+{
+    function.calls += 1;
+
+    std::string key = std::to_string(function.id);
+    key += ':';
+
+    for(uint32_t i = 0; i < num_args; ++i)
+    {
+        if(!append_value_key(args[i], key))
+            return callable.invoke(args, num_args);
+    }
+
+    std::shared_ptr<const StoredValue> stored;
+
+    if(lookup(key, stored))
+    {
+        function.shared_hits += 1;
+        return load_value(mem, *stored);
+    }
+
+    // Not locked, so slow functions do not block other callers
+    auto result = callable.invoke(args, num_args);
+
+    std::shared_ptr<StoredValue> copy(new StoredValue());
+    if(store_value(result, *copy))
+        store(key, function, copy);
+
+    return result;
+}
+
+bool FunctionCache::lookup(const std::string &key, std::shared_ptr<const StoredValue> &result)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if(it == m_entries.end())
+        return false;
+
+    if(it->second.expires <= clock::now())
+    {
+        m_order.erase(it->second.position);
+        m_entries.erase(it);
+        return false;
+    }
+
+    m_order.splice(m_order.begin(), m_order, it->second.position);
+    result = it->second.result;
+    return true;
+}
+
+void FunctionCache::store(const std::string &key, const Function &function, const std::shared_ptr<const StoredValue> &result)
+{
+    auto expires = function.ttl == clock::duration::zero() ? clock::time_point::max() : clock::now() + function.ttl;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+
+    if(it != m_entries.end())
+    {
+        it->second.result = result;
+        it->second.expires = expires;
+        m_order.splice(m_order.begin(), m_order, it->second.position);
+        return;
+    }
+
+    if(m_entries.size() >= m_max_entries)
+    {
+        m_entries.erase(*m_order.back());
+        m_order.pop_back();
+    }
+
+    it = m_entries.emplace(key, Entry{result, expires, m_order.end()}).first;
+    m_order.push_front(&it->first);
+    it->second.position = m_order.begin();
+}
+
+FunctionCache::Stats FunctionCache::stats(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_function_names.find(name);
+    if(it == m_function_names.end())
+        throw std::runtime_error("No such function: " + name);
+
+    Stats result;
+    result.calls = it->second->calls;
+    result.execution_hits = it->second->execution_hits;
+    result.shared_hits = it->second->shared_hits;
+    return result;
+}
+
+size_t FunctionCache::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+}
+
+void FunctionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+    m_order.clear();
+}
+
+}
@@ -0,0 +1,302 @@
+#include "chipy/Inputs.h"
+#include "chipy/Dictionary.h"
+#include "chipy/Scope.h"
+#include "SyntaxTree.h"
+
+namespace chipy
+{
+
+static bool is_prefix(const InputPath &prefix, const InputPath &path)
+{
+    if(prefix.size() > path.size())
+        return false;
+
+    for(size_t i = 0; i < prefix.size(); ++i)
+    {
+        if(prefix[i] != path[i])
+            return false;
+    }
+
+    return true;
+}
+
+void InputSet::add(const InputPath &path)
+{
+    for(auto it = m_paths.begin(); it != m_paths.end();)
+    {
+        if(is_prefix(*it, path))
+            return;
+
+        if(is_prefix(path, *it))
+            it = m_paths.erase(it);
+        else
+            ++it;
+    }
+
+    m_paths.insert(path);
+}
+
+std::set<std::string> InputSet::names() const
+{
+    std::set<std::string> result;
+
+    for(auto &path: m_paths)
+        result.insert(path[0]);
+
+    return result;
+}
+
+bool InputSet::reads(const InputPath &path) const
+{
+    for(auto &p: m_paths)
+    {
+        if(is_prefix(p, path) || is_prefix(path, p))
+            return true;
+    }
+
+    return false;
+}
+
+static ValuePtr project_document(MemoryManager &mem, const json::Document &doc, const std::set<InputPath> &paths)
+{
+    bool whole = doc.get_type() != json::ObjectType::Map;
+
+    for(auto &path: paths)
+    {
+        // Keys with dots cannot be looked up as document paths
+        if(path.empty() || path[0].find('.') != std::string::npos)
+            whole = true;
+    }
+
+    if(whole)
+        return mem.create_from_document(doc);
+
+    std::map<std::string, std::set<InputPath>> children;
+
+    for(auto &path: paths)
+        children[path[0]].insert(InputPath(path.begin()+1, path.end()));
+
+    auto dict = mem.create_dictionary();
+
+    for(auto &it: children)
+    {
+        json::Document child(doc, it.first, false);
+
+        if(child.empty())
+            continue;
+
+        dict->insert(it.first, project_document(mem, child, it.second));
+    }
+
+    return dict;
+}
+
+ValuePtr InputSet::project(MemoryManager &mem, const std::string &name, const json::Document &doc) const
+{
+    std::set<InputPath> paths;
+
+    for(auto &path: m_paths)
+    {
+        if(path[0] == name)
+            paths.insert(InputPath(path.begin()+1, path.end()));
+    }
+
+    if(paths.empty())
+        return mem.create_none();
+
+    return project_document(mem, doc, paths);
+}
+
+class InputAnalyzer
+{
+public:
+    typedef std::set<std::string> Bound;
+
+    void visit(const Node &node, Bound &bound)
+    {
+        auto &children = node.children;
+
+        switch(node.type)
+        {
+        case NodeType::Name:
+        {
+            if(is_input(node.name, bound))
+                m_inputs.add(InputPath{node.name});
+            break;
+        }
+        case NodeType::Subscript:
+        {
+            InputPath path;
+
+            if(input_path(node, bound, path))
+                m_inputs.add(path);
+            else
+                visit_children(node, bound);
+            break;
+        }
+        case NodeType::Attribute:
+            visit(*children[0], bound);
+            break;
+        case NodeType::Assign:
+        {
+            visit(*children[0], bound);
+
+            for(size_t i = 1; i < children.size(); ++i)
+                bind(*children[i], bound);
+            break;
+        }
+        case NodeType::AugmentedAssign:
+        {
+            visit(*children[0], bound);
+            visit(*children[1], bound);
+            bind(*children[0], bound);
+            break;
+        }
+        case NodeType::Import:
+        case NodeType::ImportFrom:
+        {
+            auto &alias = *children.back();
+            bound.insert(alias.as_name.empty() ? alias.name : alias.as_name);
+            break;
+        }
+        case NodeType::If:
+        case NodeType::WhileLoop:
+        {
+            // The body might not run, so its assignments do not count afterwards
+            visit(*children[0], bound);
+
+            Bound inner = bound;
+            visit(*children[1], inner);
+            break;
+        }
+        case NodeType::IfElse:
+        {
+            visit(*children[0], bound);
+
+            Bound body = bound;
+            Bound orelse = bound;
+            visit(*children[1], body);
+            visit(*children[2], orelse);
+
+            bound.clear();
+            for(auto &name: body)
+            {
+                if(orelse.count(name))
+                    bound.insert(name);
+            }
+            break;
+        }
+        case NodeType::ForLoop:
+        {
+            visit(*children[1], bound);
+
+            Bound inner = bound;
+            bind(*children[0], inner);
+            visit(*children[2], inner);
+            break;
+        }
+        case NodeType::RangeLoop:
+        {
+            for(size_t i = 0; i+1 < children.size(); ++i)
+                visit(*children[i], bound);
+
+            Bound inner = bound;
+            inner.insert(node.name);
+            visit(*children.back(), inner);
+            break;
+        }
+        case NodeType::ItemsLoop:
+        {
+            visit(*children[0], bound);
+
+            Bound inner = bound;
+            inner.insert(node.name);
+            inner.insert(node.as_name);
+            visit(*children[1], inner);
+            break;
+        }
+        default:
+            visit_children(node, bound);
+        }
+    }
+
+    const InputSet& inputs() const
+    {
+        return m_inputs;
+    }
+
+private:
+    void visit_children(const Node &node, Bound &bound)
+    {
+        for(auto &child: node.children)
+            visit(*child, bound);
+    }
+
+    bool is_input(const std::string &name, const Bound &bound) const
+    {
+        if(bound.count(name) || name == "True" || name == "False")
+            return false;
+
+        return !Scope::is_builtin_name(name);
+    }
+
+    // Is node an input read through constant subscripts only?
+    bool input_path(const Node &node, const Bound &bound, InputPath &path) const
+    {
+        if(node.type == NodeType::Name)
+        {
+            if(!is_input(node.name, bound))
+                return false;
+
+            path.push_back(node.name);
+            return true;
+        }
+
+        if(node.type != NodeType::Subscript)
+            return false;
+
+        auto &slice = *node.children[0];
+
+        if(slice.type != NodeType::Index)
+            return false;
+
+        auto &key = *slice.children[0];
+
+        if(key.type != NodeType::String && key.type != NodeType::Integer)
+            return false;
+
+        if(!input_path(*node.children[1], bound, path))
+            return false;
+
+        if(key.type == NodeType::String)
+            path.push_back(key.name);
+        else
+            path.push_back(std::to_string(key.integer));
+
+        return true;
+    }
+
+    void bind(const Node &target, Bound &bound)
+    {
+        if(target.type == NodeType::Name || target.type == NodeType::String)
+            bound.insert(target.name);
+
+        for(auto &child: target.children)
+            bind(*child, bound);
+    }
+
+    InputSet m_inputs;
+};
+
+InputSet analyze_inputs(const BitStream &data)
+{
+    auto program = decode_program(data);
+
+    InputAnalyzer analyzer;
+    InputAnalyzer::Bound bound;
+    analyzer.visit(*program, bound);
+
+    return analyzer.inputs();
+}
+
+}
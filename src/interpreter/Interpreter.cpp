@@ -3,62 +3,18 @@
 
 #include "chipy/Interpreter.h"
 #include "chipy/Callable.h"
+#include "chipy/CppObject.h"
 #include "chipy/Scope.h"
+#include "Builtin.h"
+#include "ValueKey.h"
 #include "RangeIterator.h"
+#include "Operators.h"
+#include "SyntaxTree.h"
 #include "modules/modules.h"
 
 namespace chipy
 {
 
-enum class CompareOpType
-{
-    Undefined,
-    Equals,
-    In,
-    Is,
-    IsNot,
-    Less,
-    LessEqual,
-    More,
-    MoreEqual,
-    NotEqual,
-    NotIn,
-};
-
-enum class BoolOpType
-{
-    Undefined,
-    And,
-    Or
-};
-
-enum class BinaryOpType
-{
-    Undefined,
-    Add,
-    BitAnd,
-    BitOr,
-    BitXor,
-    Div,
-    FloorDiv,
-    LeftShift,
-    Mod,
-    Mult,
-    Power,
-    RightShift,
-    Sub
-};
-
-enum class UnaryOpType
-{
-    Undefined,
-    Add,
-    Invert,
-    Not,
-    Sub,
-};
-
-
 ModulePtr Interpreter::get_module(const std::string &name)
 {
     auto it = m_loaded_modules.find(name);
@@ -88,6 +44,9 @@ void Interpreter::load_from_module(Scope &scope, const std::string &mname, const
     if(!module)
         throw std::runtime_error("Unknown module: " + mname);
 
+    if(m_track_reads && !module->is_deterministic())
+        m_reads_complete = false;
+
     scope.set_value(as_name == "" ? name: as_name, module->get_member(name));
 }
 
@@ -98,11 +57,25 @@ void Interpreter::load_module(Scope &scope, const std::string &mname, const std:
     if(!module)
         throw std::runtime_error("Unknown module: " + mname);
 
+    if(m_track_reads && !module->is_deterministic())
+        m_reads_complete = false;
+
     scope.set_value(as_name == "" ? mname: as_name, module);
 }
 
 bool Interpreter::execute()
 {
+    m_data.move_to(0);
+
+    if(m_track_reads)
+    {
+        m_reads.clear();
+        m_read_values.clear();
+        m_read_paths.clear();
+        m_read_path_indices.clear();
+        m_reads_complete = true;
+    }
+
     LoopState loop_state = LoopState::None;
     ValuePtr val = execute_next(*m_global_scope, loop_state);
 
@@ -112,6 +85,403 @@ bool Interpreter::execute()
     return value_cast<BoolVal>(val)->get();
 }
 
+void Interpreter::prepare(const Node &node)
+{
+    if(node.type == NodeType::ConstantSet)
+    {
+        NodeType type;
+        m_data.move_to(node.position);
+        m_data >> type;
+
+        auto set = read_constant_set();
+        m_constant_sets.emplace(node.position, ConstantSet{set, m_data.pos()});
+    }
+    else if(node.type == NodeType::Attribute)
+    {
+        m_attribute_caches.push_back(AttributeCache());
+        m_attribute_positions[node.position] = m_attribute_caches.size();
+    }
+    else if(node.type == NodeType::Import)
+        get_module(node.children[0]->name);
+    else if(node.type == NodeType::ImportFrom)
+        get_module(node.children[0]->name);
+
+    for(auto &child: node.children)
+        prepare(*child);
+}
+
+void Interpreter::prepare()
+{
+    m_attribute_positions.assign(m_data.size(), 0);
+    m_attribute_caches.clear();
+
+    prepare(*decode_program(m_data));
+    m_data.move_to(0);
+}
+
+void Interpreter::reset()
+{
+    m_global_scope->clear();
+
+    // Keeps the slots, but not the values of the last execution
+    for(auto &cache: m_attribute_caches)
+        cache = AttributeCache();
+
+    m_reads.clear();
+    m_read_values.clear();
+    m_pure_results.clear();
+    m_cache_slots.clear();
+}
+
+void Interpreter::set_read_tracking(bool enabled)
+{
+    if(enabled && !m_track_reads)
+        m_bound_names = analyze_bindings(*decode_program(m_data)).names;
+
+    m_track_reads = enabled;
+}
+
+void Interpreter::add_read(const InputPath &path, const ValuePtr &value)
+{
+    auto it = m_read_path_indices.find(path);
+
+    if(it == m_read_path_indices.end())
+    {
+        it = m_read_path_indices.emplace(path, m_read_paths.size()).first;
+        m_read_paths.push_back(path);
+    }
+
+    m_reads.push_back(ReadEvent{it->second, value, false});
+
+    if(value)
+        m_read_values[value.get()] = it->second;
+}
+
+void Interpreter::track_name(const std::string &name, const ValuePtr &value)
+{
+    // Builtins are skipped below, as they are callable; globals may shadow them
+    if(m_bound_names.count(name) || name == Scope::BUILTIN_STR_NONE)
+        return;
+
+    if(value && value->type() == ValueType::Module)
+    {
+        if(!std::static_pointer_cast<Module>(value)->is_deterministic())
+            m_reads_complete = false;
+        return;
+    }
+
+    // Functions are code rather than data
+    if(value && value->is_callable())
+        return;
+
+    add_read(InputPath{name}, value);
+}
+
+void Interpreter::track_subscript(const ValuePtr &container, const ValuePtr &key, const ValuePtr &value, size_t num_reads)
+{
+    auto it = m_read_values.find(container.get());
+    if(it == m_read_values.end())
+        return;
+
+    auto path = m_read_paths[it->second];
+
+    if(key->type() == ValueType::String)
+        path.push_back("s" + value_cast<StringVal>(key)->get());
+    else
+        path.push_back("i" + std::to_string(value_cast<IntVal>(key)->get()));
+
+    // The container was only read to get to this value
+    if(m_reads.size() > num_reads && m_reads.back().value == container)
+        m_reads.back().subscripted = true;
+
+    add_read(path, value);
+}
+
+ValuePtr Interpreter::call_pure(const std::shared_ptr<Callable> &function, const ValuePtr *args, uint32_t num_args)
+{
+    std::string key = std::to_string(reinterpret_cast<uintptr_t>(function.get()));
+    key += ':';
+
+    for(uint32_t i = 0; i < num_args; ++i)
+    {
+        if(!append_value_key(args[i], key))
+            return function->invoke(args, num_args);
+    }
+
+    auto it = m_pure_results.find(key);
+    if(it != m_pure_results.end())
+    {
+        function->count_reused_result();
+        return it->second.result;
+    }
+
+    auto result = function->invoke(args, num_args);
+
+    // The program could modify containers, so they are not shared between calls
+    if(!result || result->type() == ValueType::Bool || result->type() == ValueType::Integer
+       || result->type() == ValueType::Float || result->type() == ValueType::String)
+        m_pure_results.emplace(key, PureResult{function, result});
+
+    return result;
+}
+
+std::vector<Interpreter::Read> Interpreter::reads() const
+{
+    std::vector<Read> result;
+    std::vector<bool> seen(m_read_paths.size(), false);
+
+    for(auto &read: m_reads)
+    {
+        if(read.subscripted || seen[read.path])
+            continue;
+
+        seen[read.path] = true;
+        result.push_back(Read{m_read_paths[read.path], read.value});
+    }
+
+    return result;
+}
+
+bool Interpreter::resolve(const InputPath &path, ValuePtr &value)
+{
+    if(path.empty() || path[0] == Scope::BUILTIN_STR_NONE || !m_global_scope->has_value(path[0]))
+        return false;
+
+    value = m_global_scope->get_value(path[0]);
+
+    for(size_t i = 1; i < path.size(); ++i)
+    {
+        auto &key = path[i];
+
+        if(!value || key.empty())
+            return false;
+
+        if(key[0] == 's' && value->type() == ValueType::Dictionary)
+            value = value_cast<Dictionary>(value)->get(key.substr(1));
+        else if(key[0] == 'i' && (value->type() == ValueType::List || value->type() == ValueType::Tuple))
+        {
+            auto index = std::stol(key.substr(1));
+
+            if(value->type() == ValueType::List)
+            {
+                auto list = value_cast<List>(value);
+                if(index < 0 || static_cast<uint32_t>(index) >= list->size())
+                    return false;
+
+                value = list->get(index);
+            }
+            else
+            {
+                auto tuple = value_cast<Tuple>(value);
+                if(index < 0 || static_cast<uint32_t>(index) >= tuple->size())
+                    return false;
+
+                value = tuple->get(index);
+            }
+        }
+        else
+            return false;
+    }
+
+    return true;
+}
+
+void Interpreter::set_shared_values(const std::map<uint32_t, uint32_t> &slots, std::vector<ValuePtr> *values)
+{
+    m_shared_positions.assign(m_data.size(), 0);
+    m_shared_slots.clear();
+    m_shared_values = values;
+
+    for(auto &it: slots)
+    {
+        if(it.second >= values->size())
+            throw std::runtime_error("Invalid shared value");
+
+        // Cached values skip straight to the end of the expression
+        m_data.move_to(it.first);
+        skip_next();
+
+        m_shared_slots.push_back(SharedValue{it.second, m_data.pos()});
+        m_shared_positions[it.first] = m_shared_slots.size();
+    }
+}
+
+ValuePtr Interpreter::binary_op(BinaryOpType type, const ValuePtr &left, const ValuePtr &right)
+{
+    switch(type)
+    {
+    case BinaryOpType::Add:
+    {
+        if(left->type() == ValueType::Integer && right->type() == ValueType::Integer)
+        {
+            auto i1 = static_cast<const IntVal&>(*left).get();
+            auto i2 = static_cast<const IntVal&>(*right).get();
+
+            return m_mem.create_integer(i1 + i2);
+        }
+        else if(left->type() == ValueType::String && right->type() == ValueType::String)
+        {
+            auto &s1 = static_cast<const StringVal&>(*left).get();
+            auto &s2 = static_cast<const StringVal&>(*right).get();
+
+            return m_mem.create_string(s1 + s2);
+        }
+        else
+            throw std::runtime_error("failed to add");
+    }
+    case BinaryOpType::Mult:
+    {
+        if(left->type() == ValueType::Integer && right->type() == ValueType::Integer)
+        {
+            auto i1 = static_cast<const IntVal&>(*left).get();
+            auto i2 = static_cast<const IntVal&>(*right).get();
+
+            return m_mem.create_integer(i1 * i2);
+        }
+        else
+            throw std::runtime_error("failed to multiply");
+    }
+    case BinaryOpType::Sub:
+    {
+        if(!left || !right)
+        {
+            throw std::runtime_error("Cannot subtract on none values");
+        }
+        else if(left->type() == ValueType::Integer && right->type() == ValueType::Integer)
+        {
+            auto i1 = static_cast<const IntVal&>(*left).get();
+            auto i2 = static_cast<const IntVal&>(*right).get();
+
+            return m_mem.create_integer(i1 - i2);
+        }
+        else
+            throw std::runtime_error("failed to sub");
+    }
+    default:
+        throw std::runtime_error("Unknown binary operation");
+    }
+}
+
+bool Interpreter::compare(CompareOpType type, const ValuePtr &left, const ValuePtr &right)
+{
+    // None, e.g. from a missing key, is only equal to itself
+    if((!left || !right) && (type == CompareOpType::Equals || type == CompareOpType::NotEqual))
+        return (!left && !right) == (type == CompareOpType::Equals);
+    else if((!left || !right) && type != CompareOpType::In && type != CompareOpType::NotIn)
+        throw std::runtime_error("Cannot compare None");
+
+    switch(type)
+    {
+    case CompareOpType::Equals:
+        return *left == *right;
+    case CompareOpType::MoreEqual:
+        return *left >= *right;
+    case CompareOpType::More:
+        return *left > *right;
+    case CompareOpType::In:
+        return contains(right, left);
+    case CompareOpType::NotEqual:
+        return !(*left == *right);
+    case CompareOpType::NotIn:
+        return !contains(right, left);
+    case CompareOpType::LessEqual:
+        return *right >= *left;
+    case CompareOpType::Less:
+        return *right > *left;
+    default:
+        throw std::runtime_error("Unknown op type");
+    }
+}
+
+const ValuePtr& Interpreter::boolean_value(bool value)
+{
+    return value ? m_true : m_false;
+}
+
+ValuePtr Interpreter::run_loop(Scope &scope, const std::vector<std::string> &names, const ValuePtr &obj)
+{
+    IteratorPtr iter = nullptr;
+
+    if(obj && obj->is_generator())
+        iter = value_cast<Iterator>(obj);
+    else if(obj && obj->can_iterate())
+        iter = value_cast<IterateableValue>(obj)->iterate();
+    else
+        throw std::runtime_error("Can't iterate");
+
+    LoopState for_loop_state = LoopState::TopLevel;
+    ValuePtr returnval = nullptr;
+    ValuePtr next = nullptr;
+
+    while(for_loop_state != LoopState::Break && !scope.is_terminated() && iter->next(next))
+    {
+        Scope body_scope(m_mem, scope);
+
+        if(for_loop_state == LoopState::Continue)
+            for_loop_state = LoopState::TopLevel;
+
+        assign_names(body_scope, names, next);
+
+        auto res = execute_next(body_scope, for_loop_state);
+
+        if(scope.is_terminated())
+            returnval = res;
+    }
+
+    skip_next();
+    return returnval;
+}
+
+bool Interpreter::contains(const ValuePtr &container, const ValuePtr &value)
+{
+    if(!container)
+        throw std::runtime_error("Can only call in on lists and sets");
+
+    if(container->type() == ValueType::Set)
+    {
+        if(!value)
+            return false;
+
+        return value_cast<Set>(container)->contains(*value);
+    }
+    else if(container->type() == ValueType::List)
+    {
+        if(!value)
+            return false;
+
+        return value_cast<List>(container)->contains(*value);
+    }
+    else
+        throw std::runtime_error("Can only call in on lists and sets");
+}
+
+SetPtr Interpreter::read_constant_set()
+{
+    auto set = m_mem.create_set();
+
+    uint32_t num_integers = 0;
+    m_data >> num_integers;
+
+    for(uint32_t i = 0; i < num_integers; ++i)
+    {
+        int32_t val;
+        m_data >> val;
+        set->insert(m_mem.create_integer(val));
+    }
+
+    uint32_t num_strings = 0;
+    m_data >> num_strings;
+
+    for(uint32_t i = 0; i < num_strings; ++i)
+    {
+        std::string str;
+        m_data >> str;
+        set->insert(m_mem.create_string(str));
+    }
+
+    return set;
+}
+
 std::vector<std::string> Interpreter::read_names()
 {
     std::vector<std::string> result;
@@ -136,11 +506,8 @@ std::vector<std::string> Interpreter::read_names()
         uint32_t num_elems = 0;
         m_data >> num_elems;
 
-        if(num_elems != 2)
-            throw std::runtime_error("Can only handle pairs");
-
-        result.push_back(read_name());
-        result.push_back(read_name());
+        for(uint32_t i = 0; i < num_elems; ++i)
+            result.push_back(read_name());
     }
     else
         throw std::runtime_error("Not a valid name");
@@ -148,6 +515,38 @@ std::vector<std::string> Interpreter::read_names()
     return result;
 }
 
+void Interpreter::assign_names(Scope &scope, const std::vector<std::string> &names, ValuePtr value)
+{
+    if(names.size() == 1)
+    {
+        scope.set_value(names[0], value);
+        return;
+    }
+
+    if(value && value->type() == ValueType::Tuple)
+    {
+        auto t = value_cast<Tuple>(value);
+
+        if(t->size() != names.size())
+            throw std::runtime_error("cannot unpack value: wrong number of elements");
+
+        for(uint32_t i = 0; i < names.size(); ++i)
+            scope.set_value(names[i], t->get(i));
+    }
+    else if(value && value->type() == ValueType::List)
+    {
+        auto l = value_cast<List>(value);
+
+        if(l->size() != names.size())
+            throw std::runtime_error("cannot unpack value: wrong number of elements");
+
+        for(uint32_t i = 0; i < names.size(); ++i)
+            scope.set_value(names[i], l->get(i));
+    }
+    else
+        throw std::runtime_error("cannot unpack value");
+}
+
 std::string Interpreter::read_name()
 {
     NodeType type;
@@ -174,6 +573,21 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
     auto start = m_data.pos();
     ValuePtr returnval = nullptr;
 
+    // The expression might already have been evaluated by another interpreter
+    ValuePtr *shared_value = nullptr;
+
+    if(start < m_shared_positions.size() && m_shared_positions[start] != 0)
+    {
+        auto &shared = m_shared_slots[m_shared_positions[start] - 1];
+        shared_value = &(*m_shared_values)[shared.index];
+
+        if(*shared_value)
+        {
+            m_data.move_to(shared.end);
+            return *shared_value;
+        }
+    }
+
     NodeType type;
     m_data >> type;
 
@@ -207,11 +621,35 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
     case NodeType::Attribute:
     {
         ValuePtr value = execute_next(scope, dummy_loop_state);
+
+        AttributeCache *cache = nullptr;
+        if(start < m_attribute_positions.size() && m_attribute_positions[start] != 0)
+            cache = &m_attribute_caches[m_attribute_positions[start] - 1];
+
+        if(cache && value && cache->module == value)
+        {
+            returnval = cache->member;
+            m_data.move_to(cache->end);
+            break;
+        }
+
         std::string name = read_name();
 
+        if(!value)
+            throw std::runtime_error("Cannot get attribute of None");
+
         if(value->type() == ValueType::Module)
         {
-            returnval = value_cast<Module>(value)->get_member(name);
+            auto module = value_cast<Module>(value);
+            returnval = module->get_member(name);
+
+            // Only modules that promise it give the same member every time
+            if(cache && module->has_fixed_members())
+                *cache = AttributeCache{value, returnval, m_data.pos()};
+        }
+        else if(value->type() == ValueType::CppObject)
+        {
+            returnval = value_cast<CppObject>(value)->get_member(name);
         }
         else if(value->type() == ValueType::Dictionary && name == "items")
         {
@@ -232,7 +670,12 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         else if(str == "True")
             returnval = m_mem.create_boolean(true);
         else
+        {
             returnval = scope.get_value(str);
+
+            if(m_track_reads)
+                track_name(str, returnval);
+        }
         break;
     }
     case NodeType::Continue:
@@ -261,21 +704,7 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         for(uint32_t i = 0; i < num_targets; ++i)
         {
             auto names = read_names();
-
-            if(names.size() == 1)
-                scope.set_value(names[0], val);
-            else if(names.size() == 2)
-            {
-                if(val->type() != ValueType::Tuple)
-                    throw std::runtime_error("cannot unpack value");
-
-                auto t = value_cast<Tuple>(val);
-
-                scope.set_value(names[0], t->first());
-                scope.set_value(names[1], t->second());
-            }
-            else
-                throw std::runtime_error("invalid number of names");
+            assign_names(scope, names, val);
         }
 
         break;
@@ -432,87 +861,89 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         auto left = execute_next(scope, dummy_loop_state);
         auto right = execute_next(scope, dummy_loop_state);
 
-        switch(type)
-        {
-        case BinaryOpType::Add:
-        {
-            if(left->type() == ValueType::Integer && right->type() == ValueType::Integer)
-            {
-                auto i1 = value_cast<IntVal>(left)->get();
-                auto i2 = value_cast<IntVal>(right)->get();
-
-                returnval = m_mem.create_integer(i1 + i2);
-            }
-            else if(left->type() == ValueType::String && right->type() == ValueType::String)
-            {
-                auto s1 = value_cast<StringVal>(left)->get();
-                auto s2 = value_cast<StringVal>(right)->get();
+        returnval = binary_op(type, left, right);
+        break;
+    }
+    case NodeType::IntegerBinaryOp:
+    {
+        BinaryOpType type;
+        m_data >> type;
 
-                returnval = m_mem.create_string(s1 + s2);
-            }
-            else
-                throw std::runtime_error("failed to add");
+        auto left = execute_next(scope, dummy_loop_state);
+        auto right = execute_next(scope, dummy_loop_state);
 
+        // The compiler only guessed the types, e.g. from a literal operand
+        if(!left || !right || left->type() != ValueType::Integer || right->type() != ValueType::Integer)
+        {
+            returnval = binary_op(type, left, right);
             break;
         }
-        case BinaryOpType::Mult:
-        {
-            if(left->type() == ValueType::Integer && right->type() == ValueType::Integer)
-            {
-                auto i1 = value_cast<IntVal>(left)->get();
-                auto i2 = value_cast<IntVal>(right)->get();
 
-                returnval = m_mem.create_integer(i1 * i2);
-            }
-            else
-                throw std::runtime_error("failed to multiply");
+        auto i1 = static_cast<const IntVal&>(*left).get();
+        auto i2 = static_cast<const IntVal&>(*right).get();
 
-            break;
-        }
- 
-        case BinaryOpType::Sub:
-        {
-            if(!left || !right)
-            {
-                throw std::runtime_error("Cannot subtract on none values");
-            }
-            else if(left->type() == ValueType::Integer && right->type() == ValueType::Integer)
-            {
-                auto i1 = value_cast<IntVal>(left)->get();
-                auto i2 = value_cast<IntVal>(right)->get();
+        if(type == BinaryOpType::Add)
+            returnval = m_mem.create_integer(i1 + i2);
+        else if(type == BinaryOpType::Sub)
+            returnval = m_mem.create_integer(i1 - i2);
+        else if(type == BinaryOpType::Mult)
+            returnval = m_mem.create_integer(i1 * i2);
+        else
+            returnval = binary_op(type, left, right);
+        break;
+    }
+    case NodeType::Return:
+    {
+        returnval = execute_next(scope, dummy_loop_state);
+        scope.terminate();
+        break;
+    }
+    case NodeType::List:
+    {
+        auto list = m_mem.create_list();
 
-                returnval = m_mem.create_integer(i1 - i2);
-            }
-            else
-                throw std::runtime_error("failed to sub");
-            break;
-        }
-        default:
-            throw std::runtime_error("Unknown binary operation");
+        uint32_t size = 0;
+        m_data >> size;
+
+        for(uint32_t i = 0; i < size; ++i)
+        {
+            auto res = execute_next(scope, dummy_loop_state);
+            list->append(res);
         }
 
+        returnval = list;
         break;
     }
-    case NodeType::Return:
+    case NodeType::Set:
     {
-        returnval = execute_next(scope, dummy_loop_state);
-        scope.terminate();
+        auto set = m_mem.create_set();
+
+        uint32_t size = 0;
+        m_data >> size;
+
+        for(uint32_t i = 0; i < size; ++i)
+        {
+            auto res = execute_next(scope, dummy_loop_state);
+            set->insert(res);
+        }
+
+        returnval = set;
         break;
     }
-    case NodeType::List:
+    case NodeType::Tuple:
     {
-        auto list = m_mem.create_list();
-
         uint32_t size = 0;
         m_data >> size;
 
+        auto tuple = m_mem.create_tuple(size);
+
         for(uint32_t i = 0; i < size; ++i)
         {
             auto res = execute_next(scope, dummy_loop_state);
-            list->append(res);
+            tuple->set(i, res);
         }
 
-        returnval = list;
+        returnval = tuple;
         break;
     }
     case NodeType::String:
@@ -523,6 +954,22 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         returnval = m_mem.create_string(str);
         break;
     }
+    case NodeType::ConstantSet:
+    {
+        auto it = m_constant_sets.find(start);
+
+        if(it != m_constant_sets.end())
+        {
+            m_data.move_to(it->second.end);
+            returnval = it->second.set;
+            break;
+        }
+
+        auto set = read_constant_set();
+        m_constant_sets.emplace(start, ConstantSet{set, m_data.pos()});
+        returnval = set;
+        break;
+    }
     case NodeType::Compare:
     {
         auto current = execute_next(scope, dummy_loop_state);
@@ -536,53 +983,79 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
             m_data >> op_type;
 
             ValuePtr rval = execute_next(scope, dummy_loop_state);
-            bool res = false;
+            current = boolean_value(compare(op_type, current, rval));
+        }
 
-            if(op_type == CompareOpType::Equals)
-            {
-                res = (*current == *rval);
-            }
-            else if(op_type == CompareOpType::MoreEqual)
-            {
-                res = (*current >= *rval);
-            }
-            else if(op_type == CompareOpType::More)
-            {
-                res = (*current > *rval);
-            }
-            else if(op_type == CompareOpType::In)
-            {
-                if(rval->type() != ValueType::List)
-                    throw std::runtime_error("Can only call in on lists");
+        returnval = current;
+        break;
+    }
+    case NodeType::IntegerCompare:
+    {
+        auto left = execute_next(scope, dummy_loop_state);
 
-                res = value_cast<List>(rval)->contains(*current);
-            }
-            else if(op_type == CompareOpType::NotEqual)
-            {
-                res = !(*current == *rval);
-            }
-            else if(op_type == CompareOpType::NotIn)
-            {
-                if(rval->type() != ValueType::List)
-                    throw std::runtime_error("Can only call in on lists");
+        CompareOpType op_type;
+        m_data >> op_type;
 
-                res = !value_cast<List>(rval)->contains(*current);
-            }
-            else if(op_type == CompareOpType::LessEqual)
-            {
-                res = (*rval >= *current);
-            }
-            else if(op_type == CompareOpType::Less)
+        auto right = execute_next(scope, dummy_loop_state);
+        bool res = false;
+
+        if(!left || !right || left->type() != ValueType::Integer || right->type() != ValueType::Integer)
+            res = compare(op_type, left, right);
+        else
+        {
+            auto i1 = static_cast<const IntVal&>(*left).get();
+            auto i2 = static_cast<const IntVal&>(*right).get();
+
+            switch(op_type)
             {
-                res = (*rval > *current);
+            case CompareOpType::Equals:
+                res = i1 == i2;
+                break;
+            case CompareOpType::NotEqual:
+                res = i1 != i2;
+                break;
+            case CompareOpType::Less:
+                res = i1 < i2;
+                break;
+            case CompareOpType::LessEqual:
+                res = i1 <= i2;
+                break;
+            case CompareOpType::More:
+                res = i1 > i2;
+                break;
+            case CompareOpType::MoreEqual:
+                res = i1 >= i2;
+                break;
+            default:
+                res = compare(op_type, left, right);
             }
-            else
-                throw std::runtime_error("Unknown op type");
+        }
 
-            current = m_mem.create_boolean(res);
+        returnval = boolean_value(res);
+        break;
+    }
+    case NodeType::StringCompare:
+    {
+        auto left = execute_next(scope, dummy_loop_state);
+
+        CompareOpType op_type;
+        m_data >> op_type;
+
+        auto right = execute_next(scope, dummy_loop_state);
+        bool res = false;
+
+        if(left && right && left->type() == ValueType::String && right->type() == ValueType::String
+           && (op_type == CompareOpType::Equals || op_type == CompareOpType::NotEqual))
+        {
+            auto &s1 = static_cast<const StringVal&>(*left).get();
+            auto &s2 = static_cast<const StringVal&>(*right).get();
+
+            res = (s1 == s2) == (op_type == CompareOpType::Equals);
         }
+        else
+            res = compare(op_type, left, right);
 
-        returnval = current;
+        returnval = boolean_value(res);
         break;
     }
     case NodeType::Index:
@@ -603,17 +1076,37 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         if(!callable->is_callable())
             throw std::runtime_error("Cannot call un-callable!");
 
+        // Output would be lost if the result was taken from a cache
+        if(m_track_reads && callable->type() == ValueType::Builtin
+           && value_cast<Builtin>(callable)->builtin_type() == BuiltinType::Print)
+            m_reads_complete = false;
+
         uint32_t num_args = 0;
         m_data >> num_args;
 
-        std::vector<ValuePtr> args;
-        for(uint32_t i = 0; i < num_args; ++i)
+        // Most calls have few arguments, so avoid allocating for them
+        const uint32_t MAX_STACK_ARGS = 8;
+        ValuePtr stack_args[MAX_STACK_ARGS];
+        std::vector<ValuePtr> heap_args;
+
+        ValuePtr *args = stack_args;
+        if(num_args > MAX_STACK_ARGS)
         {
-            auto arg = execute_next(scope, dummy_loop_state);
-            args.push_back(arg);
+            heap_args.resize(num_args);
+            args = heap_args.data();
         }
 
-        returnval = value_cast<Callable>(callable)->call(args);
+        for(uint32_t i = 0; i < num_args; ++i)
+            args[i] = execute_next(scope, dummy_loop_state);
+
+        // is_callable() already ensured this is a Callable
+        auto function = std::static_pointer_cast<Callable>(callable);
+
+        if(function->is_pure())
+            returnval = call_pure(function, args, num_args);
+        else
+            returnval = function->invoke(args, num_args);
+
         break;
     }
     case NodeType::If:
@@ -673,6 +1166,7 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
     case NodeType::Subscript:
     {
         auto slice = execute_next(scope, dummy_loop_state);
+        auto num_reads = m_reads.size();
         auto val = execute_next(scope, dummy_loop_state);
 
         if(val->type() == ValueType::Dictionary && slice->type() == ValueType::String)
@@ -683,9 +1177,16 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         {
              returnval = value_cast<List>(val)->get(value_cast<IntVal>(slice)->get());
         }
+        else if(val->type() == ValueType::Tuple && slice->type() == ValueType::Integer)
+        {
+             returnval = value_cast<Tuple>(val)->get(value_cast<IntVal>(slice)->get());
+        }
         else
             throw std::runtime_error("Invalid subscript");
 
+        if(m_track_reads)
+            track_subscript(val, slice, returnval, num_reads);
+
         break;
     }
     case NodeType::WhileLoop:
@@ -693,10 +1194,17 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         LoopState for_loop_state = LoopState::TopLevel;
         auto start = m_data.pos();
  
-        while(for_loop_state != LoopState::Break)
+        while(true)
         {
             m_data.move_to(start);
 
+            if(for_loop_state == LoopState::Break || scope.is_terminated())
+            {
+                skip_next();
+                skip_next();
+                break;
+            }
+
             auto test = execute_next(scope, dummy_loop_state);
             bool cond = test && test->bool_test();
             
@@ -706,58 +1214,172 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
                 break;
             }
 
+            if(for_loop_state == LoopState::Continue)
+                for_loop_state = LoopState::TopLevel;
+
             Scope body_scope(m_mem, scope);
-            execute_next(body_scope, for_loop_state);
+            auto res = execute_next(body_scope, for_loop_state);
+
+            if(scope.is_terminated())
+                returnval = res;
         }
         break;
     }
     case NodeType::ForLoop:
     {
         const std::vector<std::string> names = read_names();
-        LoopState for_loop_state = LoopState::TopLevel;
 
         auto obj = execute_next(scope, dummy_loop_state);
-        IteratorPtr iter = nullptr;
+        returnval = run_loop(scope, names, obj);
+        break;
+    }
+    case NodeType::ItemsLoop:
+    {
+        std::string key_name, value_name;
+        m_data >> key_name >> value_name;
+
+        auto obj = execute_next(scope, dummy_loop_state);
+        LoopState for_loop_state = LoopState::TopLevel;
 
-        if(obj->is_generator())
+        if(!obj)
+            throw std::runtime_error("Cannot get attribute of None");
+
+        // Other receivers get the same items() call and errors as an unfused loop
+        if(obj->type() != ValueType::Dictionary)
         {
-            iter = value_cast<Iterator>(obj);
+            ValuePtr member;
+
+            if(obj->type() == ValueType::Module)
+                member = value_cast<Module>(obj)->get_member("items");
+            else if(obj->type() == ValueType::CppObject)
+                member = value_cast<CppObject>(obj)->get_member("items");
+            else
+                throw std::runtime_error("Cannot get attribute");
+
+            if(!member || !member->is_callable())
+                throw std::runtime_error("Cannot call un-callable!");
+
+            auto function = std::static_pointer_cast<Callable>(member);
+            auto items = function->is_pure() ? call_pure(function, nullptr, 0) : function->invoke(nullptr, 0);
+
+            returnval = run_loop(scope, {key_name, value_name}, items);
+            break;
         }
-        else if(obj->can_iterate())
+
+        auto dict = value_cast<Dictionary>(obj);
+
+        // Key and value are bound directly, without building a tuple per entry
+        Scope loop_scope(m_mem, scope);
+
+        for(auto &entry: dict->elements())
         {
-            iter = value_cast<IterateableValue>(obj)->iterate();
+            if(for_loop_state == LoopState::Break || scope.is_terminated())
+                break;
+
+            if(for_loop_state == LoopState::Continue)
+                for_loop_state = LoopState::TopLevel;
+
+            loop_scope.set_value(key_name, dict->key_value(entry));
+            loop_scope.set_value(value_name, entry.second);
+
+            Scope body_scope(m_mem, loop_scope);
+            auto res = execute_next(body_scope, for_loop_state);
+
+            if(scope.is_terminated())
+                returnval = res;
         }
-        else
-            throw std::runtime_error("Can't iterate");
 
-        while(for_loop_state != LoopState::Break)
+        skip_next();
+        break;
+    }
+    case NodeType::RangeLoop:
+    {
+        std::string name;
+        uint32_t num_args = 0;
+        m_data >> name >> num_args;
+
+        if(num_args < 1 || num_args > 3)
+            throw std::runtime_error("Invalid number of arguments");
+
+        // Globals may shadow the builtin; the loop then calls whatever range is
+        auto range = scope.get_value(Scope::BUILTIN_STR_RANGE);
+
+        if(m_track_reads)
+            track_name(Scope::BUILTIN_STR_RANGE, range);
+
+        if(!range || range->type() != ValueType::Builtin
+           || value_cast<Builtin>(range)->builtin_type() != BuiltinType::Range)
         {
-            Scope body_scope(m_mem, scope);
-            ValuePtr next = nullptr;
+            if(!range || !range->is_callable())
+                throw std::runtime_error("Cannot call un-callable!");
+
+            ValuePtr args[3];
+            for(uint32_t i = 0; i < num_args; ++i)
+                args[i] = execute_next(scope, dummy_loop_state);
+
+            auto function = std::static_pointer_cast<Callable>(range);
+            auto obj = function->is_pure() ? call_pure(function, args, num_args) : function->invoke(args, num_args);
+
+            returnval = run_loop(scope, {name}, obj);
+            break;
+        }
+
+        int32_t bounds[3] = {0, 0, 0};
+
+        for(uint32_t i = 0; i < num_args; ++i)
+        {
+            auto arg = execute_next(scope, dummy_loop_state);
+
+            if(arg == nullptr || arg->type() != ValueType::Integer)
+                throw std::runtime_error("invalid argument type");
+
+            bounds[i] = value_cast<IntVal>(arg)->get();
+        }
+
+        int64_t pos = 0, end = bounds[0], step = 1;
 
-            try {
-                next = iter->next();
-            } catch(stop_iteration_exception) {
+        if(num_args > 1)
+        {
+            pos = bounds[0];
+            end = bounds[1];
+        }
+
+        if(num_args > 2)
+            step = bounds[2];
+
+        if(step == 0)
+            throw std::runtime_error("range() step must not be zero");
+
+        LoopState for_loop_state = LoopState::TopLevel;
+
+        // The counter itself stays unboxed; the boxed value bound to the name
+        // is reused unless the loop body kept a reference to it
+        Scope loop_scope(m_mem, scope);
+        IntValPtr counter = nullptr;
+
+        for(; step > 0 ? pos < end : pos > end; pos += step)
+        {
+            if(for_loop_state == LoopState::Break || scope.is_terminated())
                 break;
-            }
 
-            if(names.size() == 1)
+            if(for_loop_state == LoopState::Continue)
+                for_loop_state = LoopState::TopLevel;
+
+            if(counter && counter.use_count() == 2 && loop_scope.get_value(name) == counter)
             {
-                body_scope.set_value(names[0], next);
+                counter->set(pos);
             }
-            else if(names.size() == 2)
+            else
             {
-                auto t = value_cast<Tuple>(next);
-                if(!t)
-                    throw std::runtime_error("Not a tuple!");
-
-                body_scope.set_value(names[0], t->first());
-                body_scope.set_value(names[1], t->second());
+                counter = m_mem.create_integer(pos);
+                loop_scope.set_value(name, counter);
             }
-            else
-                throw std::runtime_error("Cannot handle more than two names");
 
-            execute_next(body_scope, for_loop_state);
+            Scope body_scope(m_mem, loop_scope);
+            auto res = execute_next(body_scope, for_loop_state);
+
+            if(scope.is_terminated())
+                returnval = res;
         }
 
         skip_next();
@@ -780,9 +1402,13 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
             if(!target || !value || target->type() != ValueType::Integer || value->type() != ValueType::Integer)
                 throw std::runtime_error("Values need to be numerics");
 
-            auto i_target = value_cast<IntVal>(target);
-            auto i_value  = value_cast<IntVal>(value);
-            i_target->set(i_target->get() + i_value->get());
+            auto result = value_cast<IntVal>(target)->get() + value_cast<IntVal>(value)->get();
+
+            // Only update in place if no other name or container holds the value
+            if(target.use_count() == 2)
+                value_cast<IntVal>(target)->set(result);
+            else
+                scope.set_value(t_name, m_mem.create_integer(result));
             break;
         }
         default:
@@ -790,10 +1416,49 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
         }
         break;
     }
+    case NodeType::CachedValue:
+    {
+        uint32_t slot = 0;
+        m_data >> slot;
+
+        if(slot >= m_cache_slots.size())
+            m_cache_slots.resize(slot + 1);
+
+        if(m_cache_slots[slot].valid)
+        {
+            returnval = m_cache_slots[slot].value;
+            skip_next();
+            break;
+        }
+
+        returnval = execute_next(scope, dummy_loop_state);
+
+        // Not a reference, as evaluating might have resized the slots
+        m_cache_slots[slot].value = returnval;
+        m_cache_slots[slot].valid = true;
+        break;
+    }
+    case NodeType::ClearCache:
+    {
+        uint32_t first = 0, count = 0;
+        m_data >> first >> count;
+
+        if(first + count > m_cache_slots.size())
+            m_cache_slots.resize(first + count);
+
+        for(uint32_t i = first; i < first + count; ++i)
+            m_cache_slots[i] = CacheSlot();
+
+        returnval = execute_next(scope, loop_state);
+        break;
+    }
     default:
         throw std::runtime_error("Unknown node type!");
     }
 
+    if(shared_value)
+        *shared_value = returnval;
+
     if(loop_state != LoopState::Normal && loop_state != LoopState::None)
         m_data.move_to(start);
 
@@ -802,6 +1467,8 @@ ValuePtr Interpreter::execute_next(Scope &scope, LoopState &loop_state)
 
 void Interpreter::skip_next()
 {
+    auto start = m_data.pos();
+
     NodeType type;
     m_data >> type;
 
@@ -820,6 +1487,26 @@ void Interpreter::skip_next()
         skip_next();
         break;
     }
+    case NodeType::RangeLoop:
+    {
+        std::string name;
+        uint32_t num_args = 0;
+        m_data >> name >> num_args;
+
+        for(uint32_t i = 0; i < num_args; ++i)
+            skip_next();
+
+        skip_next();
+        break;
+    }
+    case NodeType::ItemsLoop:
+    {
+        std::string key_name, value_name;
+        m_data >> key_name >> value_name;
+        skip_next();
+        skip_next();
+        break;
+    }
     case NodeType::Assign:
     {
         skip_next();
@@ -856,6 +1543,20 @@ void Interpreter::skip_next()
         m_data >> str;
         break;
     }
+    case NodeType::ConstantSet:
+    {
+        auto it = m_constant_sets.find(start);
+
+        if(it != m_constant_sets.end())
+            m_data.move_to(it->second.end);
+        else
+        {
+            // Kept for the next time, so skipping does not allocate again
+            auto set = read_constant_set();
+            m_constant_sets.emplace(start, ConstantSet{set, m_data.pos()});
+        }
+        break;
+    }
     case NodeType::Compare:
     {
         skip_next();
@@ -893,6 +1594,7 @@ void Interpreter::skip_next()
         break;
     }
     case NodeType::List:
+    case NodeType::Set:
     case NodeType::Tuple:
     {
         uint32_t size;
@@ -931,6 +1633,7 @@ void Interpreter::skip_next()
     }
     case NodeType::AugmentedAssign:
     case NodeType::BinaryOp:
+    case NodeType::IntegerBinaryOp:
     {
         BinaryOpType op;
         m_data >> op;
@@ -938,7 +1641,17 @@ void Interpreter::skip_next()
         skip_next();
         break;
     }
+    case NodeType::IntegerCompare:
+    case NodeType::StringCompare:
+    {
+        skip_next();
+        CompareOpType op;
+        m_data >> op;
+        skip_next();
+        break;
+    }
     case NodeType::If:
+    case NodeType::WhileLoop:
     case NodeType::Attribute:
     case NodeType::Subscript:
     {
@@ -949,6 +1662,20 @@ void Interpreter::skip_next()
     case NodeType::Break:
     case NodeType::Continue:
         break;
+    case NodeType::CachedValue:
+    {
+        uint32_t slot = 0;
+        m_data >> slot;
+        skip_next();
+        break;
+    }
+    case NodeType::ClearCache:
+    {
+        uint32_t first = 0, count = 0;
+        m_data >> first >> count;
+        skip_next();
+        break;
+    }
     default:
         throw std::runtime_error("Failed to skip unknown node type!");
     }
@@ -959,12 +1686,37 @@ void Interpreter::set_module(const std::string &name, ModulePtr module)
     m_loaded_modules[name] = module;
 }
 
+void Interpreter::set_value(const std::string &name, ValuePtr value)
+{
+    m_global_scope->set_value(name, value);
+}
+
 void Interpreter::set_string(const std::string &name, const std::string &value)
 {
     auto s = m_mem.create_string(value);
     m_global_scope->set_value(name, s);
 }
 
+void Interpreter::set_string(const std::string &name, const std::string *value)
+{
+    m_global_scope->set_value(name, m_mem.create_string(value));
+}
+
+void Interpreter::set_string(const std::string &name, const std::shared_ptr<const std::string> &value)
+{
+    m_global_scope->set_value(name, m_mem.create_string(value));
+}
+
+void Interpreter::set_list(const std::string &name, const std::vector<std::string> *list)
+{
+    m_global_scope->set_value(name, m_mem.create_string_list(list));
+}
+
+void Interpreter::set_list(const std::string &name, const std::shared_ptr<const std::vector<std::string>> &list)
+{
+    m_global_scope->set_value(name, m_mem.create_string_list(list));
+}
+
 void Interpreter::set_list(const std::string &name, const std::vector<std::string> &list)
 {
     auto l = m_mem.create_list();
@@ -979,10 +1731,52 @@ void Interpreter::set_list(const std::string &name, const std::vector<std::strin
     m_global_scope->set_value(name, l);
 }
 
+void Interpreter::set_document(const std::string &name, const json::Document &doc)
+{
+    m_global_scope->set_value(name, m_mem.create_document_view(doc));
+}
+
+void Interpreter::set_document(const std::string &name, const json::Document &doc, const InputSet &inputs)
+{
+    m_global_scope->set_value(name, inputs.project(m_mem, name, doc));
+}
+
+void Interpreter::set_json(const std::string &name, const std::string &text)
+{
+    m_global_scope->set_value(name, m_mem.create_from_json(text));
+}
+
+void Interpreter::set_set(const std::string &name, const std::vector<std::string> &elements)
+{
+    auto s = m_mem.create_set();
+
+    for(auto &e: elements)
+    {
+        s->insert(m_mem.create_string(e));
+    }
+
+    m_global_scope->set_value(name, s);
+}
+
 Interpreter::Interpreter(const BitStream &data)
 {
     m_global_scope = new (m_mem) Scope(m_mem);
     m_data.assign(data.data(), data.size(), true);
+
+    // Created before any mark, so releasing a mark never keeps them
+    m_true = m_mem.create_boolean(true);
+    m_false = m_mem.create_boolean(false);
+}
+
+Interpreter::Interpreter(const std::shared_ptr<const BitStream> &program)
+    : m_program(program)
+{
+    m_global_scope = new (m_mem) Scope(m_mem);
+    m_data.assign(program->data(), program->size(), false);
+
+    // Created before any mark, so releasing a mark never keeps them
+    m_true = m_mem.create_boolean(true);
+    m_false = m_mem.create_boolean(false);
 }
 
 Interpreter::~Interpreter()
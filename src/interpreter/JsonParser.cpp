@@ -0,0 +1,433 @@
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__SSE2__) && !defined(IS_ENCLAVE)
+#include <emmintrin.h>
+#endif
+
+#include "chipy/Object.h"
+#include "chipy/Dictionary.h"
+#include "chipy/List.h"
+#include "Number.h"
+
+namespace chipy
+{
+
+// Builds values straight from JSON text, without going through a json::Document
+class JsonParser
+{
+public:
+    static constexpr uint32_t MAX_DEPTH = 512;
+
+    JsonParser(MemoryManager &mem, const std::string &text)
+        : m_mem(mem), m_pos(text.c_str()), m_end(text.c_str() + text.size())
+    {}
+
+    ValuePtr parse()
+    {
+        auto value = parse_value(0);
+
+        skip_whitespace();
+        if(m_pos != m_end)
+            fail("trailing characters");
+
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string &reason)
+    {
+        throw std::runtime_error("Invalid JSON: " + reason);
+    }
+
+    void skip_whitespace()
+    {
+        while(m_pos != m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t'))
+            ++m_pos;
+    }
+
+    void expect(char c)
+    {
+        skip_whitespace();
+
+        if(m_pos == m_end || *m_pos != c)
+            fail(std::string("expected '") + c + "'");
+
+        ++m_pos;
+    }
+
+    bool consume(const char *word, size_t len)
+    {
+        if(static_cast<size_t>(m_end - m_pos) < len || std::string(m_pos, len) != word)
+            return false;
+
+        m_pos += len;
+        return true;
+    }
+
+    ValuePtr parse_value(uint32_t depth)
+    {
+        if(depth > MAX_DEPTH)
+            fail("nested too deeply");
+
+        skip_whitespace();
+
+        if(m_pos == m_end)
+            fail("unexpected end");
+
+        switch(*m_pos)
+        {
+        case '{':
+            return parse_object(depth);
+        case '[':
+            return parse_array(depth);
+        case '"':
+            // The parsed buffer is moved into the value rather than copied
+            return m_mem.create_string(parse_string());
+        case 't':
+            if(!consume("true", 4))
+                fail("unknown literal");
+            return m_mem.create_boolean(true);
+        case 'f':
+            if(!consume("false", 5))
+                fail("unknown literal");
+            return m_mem.create_boolean(false);
+        case 'n':
+            if(!consume("null", 4))
+                fail("unknown literal");
+            return m_mem.create_none();
+        default:
+            return parse_number();
+        }
+    }
+
+    ValuePtr parse_object(uint32_t depth)
+    {
+        ++m_pos;
+        auto dict = m_mem.create_dictionary();
+
+        skip_whitespace();
+        if(m_pos != m_end && *m_pos == '}')
+        {
+            ++m_pos;
+            return dict;
+        }
+
+        while(true)
+        {
+            skip_whitespace();
+            if(m_pos == m_end || *m_pos != '"')
+                fail("expected key");
+
+            auto key = parse_string();
+            expect(':');
+            dict->insert(std::move(key), parse_value(depth+1));
+
+            skip_whitespace();
+            if(m_pos == m_end)
+                fail("unexpected end");
+
+            if(*m_pos == '}')
+            {
+                ++m_pos;
+                return dict;
+            }
+
+            if(*m_pos != ',')
+                fail("expected ',' or '}'");
+            ++m_pos;
+        }
+    }
+
+    ValuePtr parse_array(uint32_t depth)
+    {
+        ++m_pos;
+        auto list = m_mem.create_list();
+
+        skip_whitespace();
+        if(m_pos != m_end && *m_pos == ']')
+        {
+            ++m_pos;
+            return list;
+        }
+
+        while(true)
+        {
+            list->append(parse_value(depth+1));
+
+            skip_whitespace();
+            if(m_pos == m_end)
+                fail("unexpected end");
+
+            if(*m_pos == ']')
+            {
+                ++m_pos;
+                return list;
+            }
+
+            if(*m_pos != ',')
+                fail("expected ',' or ']'");
+            ++m_pos;
+        }
+    }
+
+    // Finds the next quote, backslash or control character
+    const char* find_special(const char *pos) const
+    {
+#if defined(__SSE2__) && !defined(IS_ENCLAVE)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        // Control characters are below 0x20; the xor makes the compare unsigned
+        const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i control = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+
+        while(m_end - pos >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+
+            __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+            special = _mm_or_si128(special, _mm_cmplt_epi8(_mm_xor_si128(chunk, flip), control));
+
+            int mask = _mm_movemask_epi8(special);
+
+            if(mask != 0)
+                return pos + __builtin_ctz(mask);
+
+            pos += 16;
+        }
+#endif
+        while(pos != m_end && *pos != '"' && *pos != '\\' && static_cast<unsigned char>(*pos) >= 0x20)
+            ++pos;
+
+        return pos;
+    }
+
+    std::string parse_string()
+    {
+        ++m_pos;
+
+        auto special = find_special(m_pos);
+
+        // Fast path: no escapes, so the string can be copied as is
+        if(special != m_end && *special == '"')
+        {
+            std::string result(m_pos, special);
+            m_pos = special + 1;
+            return result;
+        }
+
+        std::string result;
+
+        while(true)
+        {
+            special = find_special(m_pos);
+            result.append(m_pos, special);
+            m_pos = special;
+
+            if(m_pos == m_end)
+                fail("unterminated string");
+
+            char c = *m_pos;
+            ++m_pos;
+
+            if(c == '"')
+                return result;
+
+            if(c != '\\')
+                fail("control character in string");
+
+            if(m_pos == m_end)
+                fail("unterminated string");
+
+            c = *m_pos;
+            ++m_pos;
+
+            switch(c)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                result += c;
+                break;
+            case 'b':
+                result += '\b';
+                break;
+            case 'f':
+                result += '\f';
+                break;
+            case 'n':
+                result += '\n';
+                break;
+            case 'r':
+                result += '\r';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'u':
+                append_codepoint(result, parse_codepoint());
+                break;
+            default:
+                fail("invalid escape");
+            }
+        }
+    }
+
+    uint32_t parse_hex4()
+    {
+        if(m_end - m_pos < 4)
+            fail("invalid unicode escape");
+
+        uint32_t value = 0;
+
+        for(int i = 0; i < 4; ++i)
+        {
+            char c = m_pos[i];
+            value <<= 4;
+
+            if(c >= '0' && c <= '9')
+                value |= c - '0';
+            else if(c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else if(c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else
+                fail("invalid unicode escape");
+        }
+
+        m_pos += 4;
+        return value;
+    }
+
+    uint32_t parse_codepoint()
+    {
+        auto high = parse_hex4();
+
+        if(high < 0xD800 || high > 0xDBFF)
+            return high;
+
+        // Surrogate pair
+        if(m_end - m_pos < 2 || m_pos[0] != '\\' || m_pos[1] != 'u')
+            fail("invalid surrogate pair");
+
+        m_pos += 2;
+        auto low = parse_hex4();
+
+        if(low < 0xDC00 || low > 0xDFFF)
+            fail("invalid surrogate pair");
+
+        return 0x10000 + ((high - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    static void append_codepoint(std::string &str, uint32_t cp)
+    {
+        if(cp < 0x80)
+        {
+            str += static_cast<char>(cp);
+        }
+        else if(cp < 0x800)
+        {
+            str += static_cast<char>(0xC0 | (cp >> 6));
+            str += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if(cp < 0x10000)
+        {
+            str += static_cast<char>(0xE0 | (cp >> 12));
+            str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            str += static_cast<char>(0xF0 | (cp >> 18));
+            str += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            str += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            str += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool at_digit() const
+    {
+        return m_pos != m_end && *m_pos >= '0' && *m_pos <= '9';
+    }
+
+    void skip_digits()
+    {
+        if(!at_digit())
+            fail("expected digit");
+
+        while(at_digit())
+            ++m_pos;
+    }
+
+    ValuePtr parse_number()
+    {
+        const char *start = m_pos;
+        bool is_float = false;
+
+        if(m_pos != m_end && *m_pos == '-')
+            ++m_pos;
+
+        if(!at_digit())
+            fail("unexpected character");
+
+        int64_t integer = 0;
+        bool overflow = false;
+
+        if(*m_pos == '0')
+        {
+            ++m_pos;
+            if(at_digit())
+                fail("leading zero");
+        }
+
+        while(at_digit())
+        {
+            if(integer > (std::numeric_limits<int64_t>::max() - 9) / 10)
+                overflow = true;
+            else
+                integer = integer * 10 + (*m_pos - '0');
+            ++m_pos;
+        }
+
+        if(m_pos != m_end && *m_pos == '.')
+        {
+            is_float = true;
+            ++m_pos;
+            skip_digits();
+        }
+
+        if(m_pos != m_end && (*m_pos == 'e' || *m_pos == 'E'))
+        {
+            is_float = true;
+            ++m_pos;
+            if(m_pos != m_end && (*m_pos == '+' || *m_pos == '-'))
+                ++m_pos;
+            skip_digits();
+        }
+
+        if(*start == '-')
+            integer = -integer;
+
+        // Integers are 32 bit, larger numbers keep their magnitude as floats
+        if(!is_float && !overflow
+                && integer >= std::numeric_limits<int32_t>::min()
+                && integer <= std::numeric_limits<int32_t>::max())
+            return m_mem.create_integer(static_cast<int32_t>(integer));
+
+        // The text is null-terminated and ends in a digit, so strtod stops where we did
+        return m_mem.create_float(parse_float(start));
+    }
+
+    MemoryManager &m_mem;
+    const char *m_pos;
+    const char *m_end;
+};
+
+ValuePtr MemoryManager::create_from_json(const std::string &text)
+{
+    JsonParser parser(*this, text);
+    return parser.parse();
+}
+
+}
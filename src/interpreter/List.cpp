@@ -12,7 +12,7 @@ ValuePtr List::duplicate()
 {
     auto d = wrap_value(new (memory_manager()) List(memory_manager()));
 
-    for(auto elem: m_elements)
+    for(auto elem: elements())
     {
         d->append(elem);
     }
@@ -30,19 +30,31 @@ ValuePtr List::get(uint32_t index)
 
 uint32_t List::size() const
 {
-    return m_elements.size();
+    return elements().size();
 }
 
 const std::vector<ValuePtr>& List::elements() const
 {
+    // Loading does not change the logical contents
+    const_cast<List*>(this)->load_all();
     return m_elements;
 }
 
+std::vector<ValuePtr>& List::elements()
+{
+    load_all();
+    return m_elements;
+}
+
+void List::load_all()
+{
+}
+
 bool List::contains(const Value &value) const
 {
-    for(auto elem: m_elements)
+    for(auto elem: elements())
     {
-        if(*elem == value)
+        if(elem && *elem == value)
             return true;
     }
 
@@ -56,6 +68,8 @@ ValueType List::type() const
 
 void List::append(ValuePtr val)
 {
+    // Lazy lists would otherwise put their own elements after val
+    load_all();
     m_elements.push_back(val);
 }
 
@@ -64,15 +78,15 @@ ListIterator::ListIterator(MemoryManager &mem, List &list)
 {
 }
 
-ValuePtr ListIterator::next() 
+bool ListIterator::next(ValuePtr &out)
 {
     if(m_pos >= m_list.size())
-        throw stop_iteration_exception();
+        return false;
 
-    auto res = m_list.get(m_pos);
+    out = m_list.get(m_pos);
     m_pos += 1;
 
-    return res;
+    return true;
 }
 
 ValuePtr ListIterator::duplicate()
@@ -1,38 +1,121 @@
+#include <stdexcept>
+
 #include <chipy/Object.h>
 
 namespace chipy
 {
 
 MemoryManager::MemoryManager()
-    : m_buffer(), m_buffer_pos(0)
+    : m_current_page(0), m_buffer_pos(0), m_num_allocs(0)
 {
-    m_buffer = new uint8_t[PAGE_SIZE];
+    add_page(PAGE_SIZE);
 }
 
-void* MemoryManager::malloc(size_t size)
+MemoryManager::~MemoryManager()
+{
+    for(auto &page: m_pages)
+        delete[] page.data;
+}
+
+void MemoryManager::next_page(size_t min_size)
 {
-/*    if(m_buffer_pos+size >= m_buffer.size())
+    m_current_page += 1;
+    m_buffer_pos = 0;
+
+    // Reuse pages that are left over from before a reset
+    while(m_current_page < m_pages.size())
     {
-        m_buffer.resize(m_buffer_pos+size);
-    }*/
+        if(m_pages[m_current_page].size >= min_size)
+            return;
+
+        m_current_page += 1;
+    }
+
+    add_page(min_size > PAGE_SIZE ? min_size : PAGE_SIZE);
+    m_current_page = m_pages.size() - 1;
+}
 
-    auto ptr = &m_buffer[m_buffer_pos];
-    auto idx = reinterpret_cast<intptr_t>(ptr);
+void MemoryManager::add_page(size_t size)
+{
+    m_pages.push_back(Page{new uint8_t[size], size, 0});
+    m_page_indices.emplace(m_pages.back().data, m_pages.size() - 1);
+}
+
+void* MemoryManager::malloc(size_t size)
+{
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    if(m_buffer_pos + size > m_pages[m_current_page].size)
+        next_page(size);
+
+    auto &page = m_pages[m_current_page];
+    auto ptr = &page.data[m_buffer_pos];
 
     m_buffer_pos += size;
+    page.num_allocs += 1;
+    m_num_allocs += 1;
 
-    m_allocs.emplace(idx, AllocInfo{size});
     return ptr;
 }
 
 void MemoryManager::free(void *ptr)
-{   
-    auto idx = reinterpret_cast<intptr_t>(ptr);
-    auto it = m_allocs.find(idx);
-    m_allocs.erase(it);
+{
+    auto addr = reinterpret_cast<const uint8_t*>(ptr);
+
+    // The page with the last start address that is not after addr
+    auto it = m_page_indices.upper_bound(addr);
+    if(it != m_page_indices.begin())
+    {
+        --it;
+        auto &page = m_pages[it->second];
+
+        if(addr < page.data + page.size)
+            page.num_allocs -= 1;
+    }
+
+    m_num_allocs -= 1;
+
+    // Nothing is alive anymore, so start over from the beginning
+    if(m_num_allocs == 0)
+    {
+        m_current_page = 0;
+        m_buffer_pos = 0;
+    }
+}
+
+MemoryManager::mark_t MemoryManager::mark()
+{
+    // Regions start on a fresh page, so liveness can be tracked per page
+    if(m_buffer_pos > 0)
+        next_page(PAGE_SIZE);
+
+    return m_current_page;
+}
+
+bool MemoryManager::release(mark_t mark)
+{
+    if(mark >= m_pages.size())
+        throw std::runtime_error("Invalid mark");
+
+    for(auto i = mark; i < m_pages.size(); ++i)
+    {
+        if(m_pages[i].num_allocs > 0)
+            return false;
+    }
 
-    //FIXME: actually reuse memory...
+    if(m_current_page >= mark)
+    {
+        m_current_page = mark;
+        m_buffer_pos = 0;
+    }
+
+    return true;
 }
 
+void RecordMark::end(MemoryManager &mem)
+{
+    if(!release(mem))
+        throw std::runtime_error("A record left values alive");
+}
 
 }
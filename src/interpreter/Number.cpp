@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef IS_ENCLAVE
+#include <locale.h>
+#endif
+
+#include "Number.h"
+
+namespace chipy
+{
+
+#ifndef IS_ENCLAVE
+// Switches the calling thread to the C locale, so the decimal point is always '.'
+class CLocale
+{
+public:
+    CLocale()
+        : m_previous(uselocale(get()))
+    {}
+
+    ~CLocale()
+    {
+        uselocale(m_previous);
+    }
+
+private:
+    static locale_t get()
+    {
+        static const locale_t locale = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+        return locale;
+    }
+
+    const locale_t m_previous;
+};
+#else
+// Enclaves cannot set a locale, so they always use the C one
+class CLocale
+{
+public:
+    CLocale() {}
+};
+#endif
+
+double parse_float(const char *text)
+{
+    CLocale locale;
+    return strtod(text, nullptr);
+}
+
+void append_float(double f, std::string &out)
+{
+    CLocale locale;
+
+    char buffer[32];
+    int len = 0;
+
+    for(int precision = 15; precision <= 17; ++precision)
+    {
+        len = snprintf(buffer, sizeof(buffer), "%.*g", precision, f);
+
+        if(strtod(buffer, nullptr) == f)
+            break;
+    }
+
+    out.append(buffer, len);
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+namespace chipy
+{
+
+// Converts a decimal float, e.g. 2.5e3, regardless of the locale the host has set
+double parse_float(const char *text);
+
+// Appends the shortest of %.15g, %.16g and %.17g that reads back as f
+void append_float(double f, std::string &out);
+
+}
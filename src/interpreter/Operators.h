@@ -0,0 +1,57 @@
+#pragma once
+
+namespace chipy
+{
+
+// Operators as they are encoded in the program
+// Must be kept in sync with the compiler
+
+enum class CompareOpType
+{
+    Undefined,
+    Equals,
+    In,
+    Is,
+    IsNot,
+    Less,
+    LessEqual,
+    More,
+    MoreEqual,
+    NotEqual,
+    NotIn,
+};
+
+enum class BoolOpType
+{
+    Undefined,
+    And,
+    Or
+};
+
+enum class BinaryOpType
+{
+    Undefined,
+    Add,
+    BitAnd,
+    BitOr,
+    BitXor,
+    Div,
+    FloorDiv,
+    LeftShift,
+    Mod,
+    Mult,
+    Power,
+    RightShift,
+    Sub
+};
+
+enum class UnaryOpType
+{
+    Undefined,
+    Add,
+    Invert,
+    Not,
+    Sub,
+};
+
+}
@@ -0,0 +1,476 @@
+#include <algorithm>
+#include <map>
+
+#include "chipy/Optimizer.h"
+#include "chipy/Scope.h"
+#include "SyntaxTree.h"
+
+namespace chipy
+{
+
+static NodePtr wrap_node(NodeType type, uint32_t slot, const NodePtr &child)
+{
+    NodePtr node(new Node());
+    node->type = type;
+    node->slot = slot;
+    node->children.push_back(child);
+    return node;
+}
+
+static uint32_t num_used_slots(const Node &node)
+{
+    uint32_t result = 0;
+
+    if(node.type == NodeType::CachedValue)
+        result = node.slot + 1;
+    else if(node.type == NodeType::ClearCache)
+        result = node.slot + node.integer;
+
+    for(auto &child: node.children)
+        result = std::max(result, num_used_slots(*child));
+
+    return result;
+}
+
+class OptimizerPass
+{
+public:
+    OptimizerPass(const std::set<std::string> &pure_functions, const Bindings &bindings, uint32_t first_slot)
+        : m_pure_functions(pure_functions), m_bindings(bindings), m_num_slots(first_slot)
+    {}
+
+    // Lets every loop evaluate the expressions that do not depend on it once
+    void hoist(NodePtr &ref)
+    {
+        auto &node = *ref;
+        auto first = m_num_slots;
+
+        if(is_loop(node) && !clobbers(node))
+        {
+            auto written = analyze_bindings(node).names;
+
+            std::vector<Occurrence> occurrences;
+            std::vector<const Node*> ancestors;
+
+            for(size_t i = first_repeated_child(node); i < node.children.size(); ++i)
+                collect(node.children[i], 0, written, false, ancestors, occurrences);
+
+            std::map<std::string, uint32_t> slots;
+
+            for(auto &occurrence: occurrences)
+            {
+                auto key = key_of(*occurrence.node);
+                auto it = slots.find(key);
+
+                if(it == slots.end())
+                    it = slots.emplace(key, m_num_slots++).first;
+
+                *occurrence.ref = wrap_node(NodeType::CachedValue, it->second, *occurrence.ref);
+            }
+
+            num_hoisted += slots.size();
+        }
+
+        auto count = m_num_slots - first;
+
+        for(auto &child: node.children)
+            hoist(child);
+
+        if(count > 0)
+            ref = clear_cache(first, count, ref);
+    }
+
+    // Lets every block evaluate the expressions it repeats once
+    void eliminate(NodePtr &ref)
+    {
+        auto &node = *ref;
+        auto first = m_num_slots;
+
+        if(node.type == NodeType::StatementList)
+            eliminate_in_block(node);
+
+        auto count = m_num_slots - first;
+
+        for(auto &child: node.children)
+            eliminate(child);
+
+        if(count > 0)
+            ref = clear_cache(first, count, ref);
+    }
+
+    uint32_t num_hoisted = 0;
+    uint32_t num_eliminated = 0;
+
+private:
+    struct Occurrence
+    {
+        NodePtr *ref;
+        const Node *node;
+
+        // Index of the statement in the block
+        size_t statement;
+
+        // Candidates that contain this one
+        std::vector<const Node*> ancestors;
+    };
+
+    void eliminate_in_block(Node &block)
+    {
+        auto &statements = block.children;
+
+        std::vector<std::set<std::string>> written(statements.size());
+        std::vector<bool> barriers(statements.size());
+        std::vector<Occurrence> occurrences;
+        std::vector<const Node*> ancestors;
+
+        for(size_t i = 0; i < statements.size(); ++i)
+        {
+            written[i] = analyze_bindings(*statements[i]).names;
+            barriers[i] = clobbers(*statements[i]);
+
+            if(!barriers[i])
+                collect(statements[i], i, written[i], true, ancestors, occurrences);
+        }
+
+        std::map<std::string, std::vector<size_t>> groups;
+        for(size_t i = 0; i < occurrences.size(); ++i)
+            groups[key_of(*occurrences[i].node)].push_back(i);
+
+        // Larger expressions first, so their parts are only reused where
+        // they also occur on their own
+        std::vector<const std::string*> keys;
+        for(auto &it: groups)
+            keys.push_back(&it.first);
+
+        std::stable_sort(keys.begin(), keys.end(), [](const std::string *a, const std::string *b) {
+            return a->size() > b->size();
+        });
+
+        std::set<const Node*> wrapped;
+
+        for(auto key: keys)
+        {
+            auto &group = groups[*key];
+
+            std::set<std::string> reads;
+            names_read(*occurrences[group[0]].node, reads);
+
+            std::vector<Occurrence*> run;
+
+            for(auto index: group)
+            {
+                auto &occurrence = occurrences[index];
+                bool inside = false;
+
+                for(auto ancestor: occurrence.ancestors)
+                    inside = inside || wrapped.count(ancestor);
+
+                if(inside)
+                    continue;
+
+                if(!run.empty())
+                {
+                    // The value might change between the two statements
+                    for(auto i = run.back()->statement + 1; i < occurrence.statement; ++i)
+                    {
+                        if(barriers[i] || intersects(written[i], reads))
+                        {
+                            share(run, wrapped);
+                            run.clear();
+                            break;
+                        }
+                    }
+                }
+
+                run.push_back(&occurrence);
+            }
+
+            share(run, wrapped);
+        }
+    }
+
+    void share(const std::vector<Occurrence*> &run, std::set<const Node*> &wrapped)
+    {
+        if(run.size() < 2)
+            return;
+
+        auto slot = m_num_slots++;
+
+        for(auto occurrence: run)
+        {
+            *occurrence->ref = wrap_node(NodeType::CachedValue, slot, *occurrence->ref);
+            wrapped.insert(occurrence->node);
+        }
+
+        num_eliminated += run.size() - 1;
+    }
+
+    // Finds the expressions below ref that can be reused and do not read written
+    // If nested is false, only the outermost ones are returned
+    void collect(NodePtr &ref, size_t statement, const std::set<std::string> &written, bool nested,
+                 std::vector<const Node*> &ancestors, std::vector<Occurrence> &out) const
+    {
+        auto &node = *ref;
+
+        if(node.type == NodeType::CachedValue || node.type == NodeType::Import || node.type == NodeType::ImportFrom)
+            return;
+
+        std::set<std::string> reads;
+        bool found = is_candidate(node);
+
+        if(found)
+        {
+            names_read(node, reads);
+            found = !intersects(reads, written);
+        }
+
+        if(found)
+        {
+            out.push_back(Occurrence{&ref, &node, statement, ancestors});
+
+            if(!nested)
+                return;
+
+            ancestors.push_back(&node);
+        }
+
+        for(size_t i = 0; i < node.children.size(); ++i)
+        {
+            if(is_evaluated(node, i))
+                collect(node.children[i], statement, written, nested, ancestors, out);
+        }
+
+        if(found)
+            ancestors.pop_back();
+    }
+
+    bool is_candidate(const Node &node) const
+    {
+        switch(node.type)
+        {
+        case NodeType::Subscript:
+        case NodeType::Attribute:
+        case NodeType::Call:
+        case NodeType::BinaryOp:
+        case NodeType::Compare:
+        case NodeType::BoolOp:
+        case NodeType::UnaryOp:
+            return is_pure(node) && is_costly(node);
+        default:
+            return false;
+        }
+    }
+
+    // Does evaluating the node have no effects and give the same value
+    // as long as the names it reads do not change?
+    bool is_pure(const Node &node) const
+    {
+        switch(node.type)
+        {
+        case NodeType::Name:
+        case NodeType::Integer:
+        case NodeType::String:
+        case NodeType::ConstantSet:
+            return true;
+        case NodeType::Attribute:
+            return is_pure(*node.children[0]);
+        case NodeType::Call:
+            if(!is_pure_function(*node.children[0]))
+                return false;
+
+            for(size_t i = 1; i < node.children.size(); ++i)
+            {
+                if(!is_pure(*node.children[i]))
+                    return false;
+            }
+            return true;
+        case NodeType::Subscript:
+        case NodeType::Index:
+        case NodeType::Compare:
+        case NodeType::BoolOp:
+        case NodeType::UnaryOp:
+        case NodeType::BinaryOp:
+        case NodeType::Tuple:
+            for(auto &child: node.children)
+            {
+                if(!is_pure(*child))
+                    return false;
+            }
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Only lookups and calls are worth keeping a value for
+    static bool is_costly(const Node &node)
+    {
+        if(node.type == NodeType::Subscript || node.type == NodeType::Attribute || node.type == NodeType::Call)
+            return true;
+
+        for(auto &child: node.children)
+        {
+            if(is_costly(*child))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool is_pure_function(const Node &callee) const
+    {
+        if(callee.type == NodeType::Name)
+        {
+            if(m_bindings.names.count(callee.name))
+                return false;
+
+            // Other builtins create iterators, sets or output
+            return callee.name == "int" || callee.name == "str" || m_pure_functions.count(callee.name);
+        }
+
+        if(callee.type == NodeType::Attribute && callee.children[0]->type == NodeType::Name
+           && callee.children[1]->type == NodeType::Name)
+        {
+            auto &module = callee.children[0]->name;
+
+            if(m_bindings.names.count(module) && !m_bindings.modules.count(module))
+                return false;
+
+            return m_pure_functions.count(module + "." + callee.children[1]->name) > 0;
+        }
+
+        return false;
+    }
+
+    // Might the node call something that changes values it did not create?
+    bool clobbers(const Node &node) const
+    {
+        if(node.type == NodeType::Call && !is_pure_function(*node.children[0]))
+        {
+            auto &callee = *node.children[0];
+
+            // Builtins do not change existing values
+            if(callee.type != NodeType::Name || !Scope::is_builtin_name(callee.name)
+               || m_bindings.names.count(callee.name))
+                return true;
+        }
+
+        for(auto &child: node.children)
+        {
+            if(clobbers(*child))
+                return true;
+        }
+
+        return false;
+    }
+
+    static void names_read(const Node &node, std::set<std::string> &names)
+    {
+        if(node.type == NodeType::Name)
+            names.insert(node.name);
+
+        for(size_t i = 0; i < node.children.size(); ++i)
+        {
+            if(is_evaluated(node, i))
+                names_read(*node.children[i], names);
+        }
+    }
+
+    // Is the child evaluated as an expression, rather than e.g. being a name that is assigned?
+    static bool is_evaluated(const Node &node, size_t index)
+    {
+        switch(node.type)
+        {
+        case NodeType::Attribute:
+            return index == 0;
+        case NodeType::Dictionary:
+            return index % 2 == 1;
+        case NodeType::Assign:
+            return index == 0;
+        case NodeType::AugmentedAssign:
+        case NodeType::ForLoop:
+            return index != 0;
+        case NodeType::Call:
+            // Callees are looked up cheaply or through the attribute cache
+            return index != 0 || node.children[0]->type != NodeType::Name;
+        default:
+            return true;
+        }
+    }
+
+    static bool is_loop(const Node &node)
+    {
+        return node.type == NodeType::ForLoop || node.type == NodeType::WhileLoop
+            || node.type == NodeType::RangeLoop || node.type == NodeType::ItemsLoop;
+    }
+
+    // The test of a while loop is evaluated for every iteration, other loops
+    // only evaluate what they iterate over once
+    static size_t first_repeated_child(const Node &loop)
+    {
+        return loop.type == NodeType::WhileLoop ? 0 : loop.children.size() - 1;
+    }
+
+    static bool intersects(const std::set<std::string> &a, const std::set<std::string> &b)
+    {
+        for(auto &name: a)
+        {
+            if(b.count(name))
+                return true;
+        }
+
+        return false;
+    }
+
+    static std::string key_of(const Node &node)
+    {
+        auto data = encode_program(node);
+        return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    static NodePtr clear_cache(uint32_t first, uint32_t count, const NodePtr &child)
+    {
+        auto node = wrap_node(NodeType::ClearCache, first, child);
+        node->integer = count;
+        return node;
+    }
+
+    const std::set<std::string> &m_pure_functions;
+    const Bindings &m_bindings;
+
+    uint32_t m_num_slots;
+};
+
+Optimizer::Optimizer(const BitStream &program)
+{
+    m_program.assign(program.data(), program.size(), true);
+}
+
+void Optimizer::add_pure_function(const std::string &name)
+{
+    m_pure_functions.insert(name);
+}
+
+BitStream Optimizer::optimize()
+{
+    auto program = decode_program(m_program);
+    auto bindings = analyze_bindings(*program);
+
+    m_num_hoisted = 0;
+    m_num_eliminated = 0;
+
+    // A reused value could have been modified since
+    if(bindings.mutates)
+        return encode_program(*program);
+
+    OptimizerPass pass(m_pure_functions, bindings, num_used_slots(*program));
+    pass.hoist(program);
+    pass.eliminate(program);
+
+    m_num_hoisted = pass.num_hoisted;
+    m_num_eliminated = pass.num_eliminated;
+
+    return encode_program(*program);
+}
+
+}
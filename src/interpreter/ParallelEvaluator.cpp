@@ -0,0 +1,178 @@
+#include "chipy/ParallelEvaluator.h"
+
+namespace chipy
+{
+
+ParallelEvaluator::ParallelEvaluator(const BitStream &program, const std::string &input_name, uint32_t num_threads)
+{
+    if(num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    if(num_threads == 0)
+        num_threads = 1;
+
+    auto shared = std::make_shared<const BitStream>(program);
+
+    for(uint32_t i = 0; i < num_threads; ++i)
+        m_workers.emplace_back(new Worker(shared, input_name));
+
+    for(uint32_t i = 0; i < num_threads; ++i)
+        m_workers[i]->thread = std::thread(&ParallelEvaluator::run, this, i);
+}
+
+ParallelEvaluator::~ParallelEvaluator()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_work_cond.notify_all();
+
+    for(auto &worker: m_workers)
+        worker->thread.join();
+}
+
+void ParallelEvaluator::setup(const std::function<void(Interpreter&)> &fn)
+{
+    // Workers are idle, and the mutex orders these writes before their next batch
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for(auto &worker: m_workers)
+        fn(worker->evaluator.interpreter());
+}
+
+std::vector<bool> ParallelEvaluator::evaluate(const json::Document *docs, size_t count)
+{
+    std::vector<uint8_t> results(count);
+
+    // Several chunks per worker, so there is something left to steal
+    size_t chunk_size = count / (m_workers.size() * 8);
+    if(chunk_size == 0)
+        chunk_size = 1;
+
+    size_t next = 0;
+    for(size_t begin = 0; begin < count; begin += chunk_size)
+    {
+        auto end = std::min(count, begin + chunk_size);
+        auto &worker = *m_workers[next];
+
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.chunks.push_back(Chunk{begin, end});
+
+        next = (next + 1) % m_workers.size();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_docs = docs;
+        m_results = results.data();
+        m_active_workers = m_workers.size();
+        m_generation += 1;
+    }
+
+    m_work_cond.notify_all();
+
+    std::exception_ptr error;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cond.wait(lock, [this] { return m_active_workers == 0; });
+
+        error = m_error;
+        m_error = nullptr;
+    }
+
+    if(error)
+        std::rethrow_exception(error);
+
+    return std::vector<bool>(results.begin(), results.end());
+}
+
+std::vector<bool> ParallelEvaluator::evaluate(const std::vector<json::Document> &docs)
+{
+    return evaluate(docs.data(), docs.size());
+}
+
+void ParallelEvaluator::run(uint32_t index)
+{
+    auto &worker = *m_workers[index];
+    uint64_t generation = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cond.wait(lock, [&] { return m_stop || m_generation != generation; });
+
+            if(m_stop)
+                return;
+
+            generation = m_generation;
+        }
+
+        Chunk chunk;
+        while(pop_chunk(index, chunk) || steal_chunk(index, chunk))
+            process(worker, chunk);
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_active_workers -= 1;
+
+            if(m_active_workers == 0)
+                m_done_cond.notify_all();
+        }
+    }
+}
+
+bool ParallelEvaluator::pop_chunk(uint32_t index, Chunk &chunk)
+{
+    auto &worker = *m_workers[index];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+
+    if(worker.chunks.empty())
+        return false;
+
+    // Owners work from the back, thieves from the front
+    chunk = worker.chunks.back();
+    worker.chunks.pop_back();
+    return true;
+}
+
+bool ParallelEvaluator::steal_chunk(uint32_t index, Chunk &chunk)
+{
+    for(uint32_t i = 1; i < m_workers.size(); ++i)
+    {
+        auto &victim = *m_workers[(index + i) % m_workers.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex);
+
+        if(!victim.chunks.empty())
+        {
+            chunk = victim.chunks.front();
+            victim.chunks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ParallelEvaluator::process(Worker &worker, const Chunk &chunk)
+{
+    for(auto i = chunk.begin; i < chunk.end; ++i)
+    {
+        try
+        {
+            m_results[i] = worker.evaluator.evaluate(m_docs[i]);
+        }
+        catch(...)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            if(!m_error)
+                m_error = std::current_exception();
+        }
+    }
+}
+
+}
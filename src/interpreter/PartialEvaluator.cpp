@@ -0,0 +1,593 @@
+#include "chipy/PartialEvaluator.h"
+#include "chipy/Dictionary.h"
+#include "chipy/List.h"
+#include "chipy/Set.h"
+#include "chipy/Tuple.h"
+#include "Operators.h"
+#include "SyntaxTree.h"
+
+namespace chipy
+{
+
+static NodePtr make_node(NodeType type, const std::string &name = "")
+{
+    NodePtr node(new Node());
+    node->type = type;
+    node->name = name;
+    return node;
+}
+
+static NodePtr make_bool(bool value)
+{
+    return make_node(NodeType::Name, value ? "True" : "False");
+}
+
+static NodePtr make_literal(const ValuePtr &value)
+{
+    if(!value)
+        return make_node(NodeType::Name, "None");
+
+    switch(value->type())
+    {
+    case ValueType::Bool:
+        return make_bool(value_cast<BoolVal>(value)->get());
+    case ValueType::Integer:
+    {
+        auto node = make_node(NodeType::Integer);
+        node->integer = value_cast<IntVal>(value)->get();
+        return node;
+    }
+    case ValueType::String:
+        return make_node(NodeType::String, value_cast<StringVal>(value)->get());
+    case ValueType::List:
+    case ValueType::Set:
+    {
+        auto &elements = value->type() == ValueType::List ? value_cast<List>(value)->elements()
+                                                          : value_cast<Set>(value)->elements();
+        auto node = make_node(value->type() == ValueType::List ? NodeType::List : NodeType::Set);
+
+        for(auto &elem: elements)
+            node->children.push_back(make_literal(elem));
+
+        return node;
+    }
+    case ValueType::Tuple:
+    {
+        auto tuple = value_cast<Tuple>(value);
+        auto node = make_node(NodeType::Tuple);
+
+        for(uint32_t i = 0; i < tuple->size(); ++i)
+            node->children.push_back(make_literal(tuple->get(i)));
+
+        return node;
+    }
+    case ValueType::Dictionary:
+    {
+        auto node = make_node(NodeType::Dictionary);
+
+        for(auto &it: value_cast<Dictionary>(value)->elements())
+        {
+            node->children.push_back(make_node(NodeType::String, it.first));
+            node->children.push_back(make_literal(it.second));
+        }
+
+        return node;
+    }
+    default:
+        // There are no literals for e.g. floats
+        throw std::runtime_error("Cannot specialize on this type of value");
+    }
+}
+
+static NodePtr copy_tree(const Node &node)
+{
+    NodePtr result(new Node(node));
+
+    for(auto &child: result->children)
+        child = copy_tree(*child);
+
+    return result;
+}
+
+class Specializer
+{
+public:
+    Specializer(const std::map<std::string, NodePtr> &known, const Bindings &bindings)
+        : m_known(known), m_bindings(bindings)
+    {}
+
+    // Returns nullptr if the statement can be removed
+    NodePtr visit(const NodePtr &node)
+    {
+        switch(node->type)
+        {
+        case NodeType::Import:
+        case NodeType::ImportFrom:
+            return node;
+        case NodeType::Attribute:
+            // The second child is the name of the member
+            visit_child(*node, 0);
+            return node;
+        case NodeType::Dictionary:
+            for(size_t i = 1; i < node->children.size(); i += 2)
+                visit_child(*node, i);
+            return node;
+        case NodeType::StatementList:
+            return visit_statements(node);
+        default:
+            break;
+        }
+
+        for(size_t i = 0; i < node->children.size(); ++i)
+            visit_child(*node, i);
+
+        switch(node->type)
+        {
+        case NodeType::Name:
+        {
+            auto value = constant(*node);
+
+            if(value && value != node.get() && is_scalar(*value))
+                return copy_tree(*value);
+
+            return node;
+        }
+        case NodeType::Subscript:
+        {
+            auto value = constant(*node);
+
+            if(value && is_scalar(*value))
+                return copy_tree(*value);
+
+            return node;
+        }
+        case NodeType::Compare:
+            return fold_compare(node);
+        case NodeType::BoolOp:
+            return fold_bool_op(node);
+        case NodeType::UnaryOp:
+        {
+            bool value;
+
+            if(static_cast<UnaryOpType>(node->op) == UnaryOpType::Not && bool_literal(*node->children[0], value))
+                return make_bool(!value);
+
+            return node;
+        }
+        case NodeType::If:
+        {
+            bool value;
+
+            if(!bool_literal(*node->children[0], value))
+                return node;
+
+            return value ? node->children[1] : nullptr;
+        }
+        case NodeType::IfElse:
+        {
+            bool value;
+
+            if(!bool_literal(*node->children[0], value))
+                return node;
+
+            return value ? node->children[1] : node->children[2];
+        }
+        case NodeType::WhileLoop:
+        {
+            bool value;
+
+            if(bool_literal(*node->children[0], value) && !value)
+                return nullptr;
+
+            return node;
+        }
+        default:
+            return node;
+        }
+    }
+
+private:
+    void visit_child(Node &parent, size_t index)
+    {
+        auto result = visit(parent.children[index]);
+
+        if(!result)
+            result = make_node(NodeType::StatementList);
+
+        parent.children[index] = result;
+    }
+
+    NodePtr visit_statements(const NodePtr &node)
+    {
+        auto &children = node->children;
+        std::vector<NodePtr> statements;
+
+        for(size_t i = 0; i < children.size(); ++i)
+        {
+            auto result = visit(children[i]);
+
+            // The last statement decides the value of the list
+            if(!result && i + 1 == children.size())
+                result = make_node(NodeType::StatementList);
+
+            if(!result)
+                continue;
+
+            statements.push_back(result);
+
+            // Everything after it would be skipped
+            if(always_returns(*result))
+                break;
+        }
+
+        children = statements;
+        return node;
+    }
+
+    static bool always_returns(const Node &node)
+    {
+        switch(node.type)
+        {
+        case NodeType::Return:
+            return true;
+        case NodeType::StatementList:
+            for(auto &child: node.children)
+            {
+                if(always_returns(*child))
+                    return true;
+            }
+            return false;
+        case NodeType::IfElse:
+            return always_returns(*node.children[1]) && always_returns(*node.children[2]);
+        default:
+            return false;
+        }
+    }
+
+    // Returns the literal node holds, if any
+    const Node* constant(const Node &node) const
+    {
+        switch(node.type)
+        {
+        case NodeType::Integer:
+        case NodeType::String:
+        case NodeType::ConstantSet:
+            return &node;
+        case NodeType::Name:
+        {
+            if(node.name == "True" || node.name == "False" || node.name == "None")
+                return &node;
+
+            auto it = m_known.find(node.name);
+
+            if(it == m_known.end() || m_bindings.names.count(node.name))
+                return nullptr;
+
+            // The program might modify containers before looking at them
+            if(!is_scalar(*it->second) && m_bindings.mutates)
+                return nullptr;
+
+            return it->second.get();
+        }
+        case NodeType::List:
+        case NodeType::Set:
+        case NodeType::Tuple:
+            for(auto &child: node.children)
+            {
+                if(!constant(*child))
+                    return nullptr;
+            }
+            return &node;
+        case NodeType::Subscript:
+        {
+            auto &slice = *node.children[0];
+            auto container = constant(*node.children[1]);
+
+            if(!container || slice.type != NodeType::Index)
+                return nullptr;
+
+            auto index = constant(*slice.children[0]);
+            if(!index)
+                return nullptr;
+
+            if(container->type == NodeType::Dictionary && index->type == NodeType::String)
+            {
+                for(size_t i = 0; i + 1 < container->children.size(); i += 2)
+                {
+                    if(container->children[i]->name == index->name)
+                        return constant(*container->children[i+1]);
+                }
+
+                // Missing keys are None
+                return &m_none;
+            }
+
+            if((container->type == NodeType::List || container->type == NodeType::Tuple) && index->type == NodeType::Integer)
+            {
+                auto i = index->integer;
+
+                if(i < 0 || static_cast<size_t>(i) >= container->children.size())
+                    return nullptr;
+
+                return constant(*container->children[i]);
+            }
+
+            return nullptr;
+        }
+        default:
+            return nullptr;
+        }
+    }
+
+    static bool is_scalar(const Node &node)
+    {
+        return node.type == NodeType::Integer || node.type == NodeType::String || node.type == NodeType::Name;
+    }
+
+    static bool bool_literal(const Node &node, bool &value)
+    {
+        if(node.type != NodeType::Name || (node.name != "True" && node.name != "False"))
+            return false;
+
+        value = (node.name == "True");
+        return true;
+    }
+
+    // Only integers and strings of the same type are compared, as the
+    // interpreter's rules for other combinations might change
+    static bool equal(const Node &left, const Node &right, bool &result)
+    {
+        if(left.type != right.type)
+            return false;
+
+        if(left.type == NodeType::Integer)
+            result = (left.integer == right.integer);
+        else if(left.type == NodeType::String)
+            result = (left.name == right.name);
+        else
+            return false;
+
+        return true;
+    }
+
+    bool contains(const Node &container, const Node &value, bool &result) const
+    {
+        result = false;
+
+        switch(container.type)
+        {
+        case NodeType::ConstantSet:
+            if(value.type == NodeType::Integer)
+            {
+                for(auto i: container.integers)
+                    result = result || (i == value.integer);
+                return true;
+            }
+            if(value.type == NodeType::String)
+            {
+                for(auto &str: container.strings)
+                    result = result || (str == value.name);
+                return true;
+            }
+            return false;
+        case NodeType::List:
+        case NodeType::Set:
+        case NodeType::Tuple:
+            if(value.type != NodeType::Integer && value.type != NodeType::String)
+                return false;
+
+            for(auto &child: container.children)
+            {
+                auto elem = constant(*child);
+                bool same;
+
+                if(!elem || !equal(*elem, value, same))
+                    return false;
+
+                result = result || same;
+            }
+            return true;
+        case NodeType::Dictionary:
+            if(value.type != NodeType::String)
+                return false;
+
+            for(size_t i = 0; i + 1 < container.children.size(); i += 2)
+                result = result || (container.children[i]->name == value.name);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    NodePtr fold_compare(const NodePtr &node) const
+    {
+        // Chains are left alone
+        if(node->ops.size() != 1)
+            return node;
+
+        auto left = constant(*node->children[0]);
+        auto right = constant(*node->children[1]);
+
+        if(!left || !right)
+            return node;
+
+        auto op = static_cast<CompareOpType>(node->ops[0]);
+        bool left_none = (left->type == NodeType::Name && left->name == "None");
+        bool right_none = (right->type == NodeType::Name && right->name == "None");
+        bool result;
+
+        switch(op)
+        {
+        case CompareOpType::Equals:
+        case CompareOpType::NotEqual:
+            if(left_none || right_none)
+                result = (left_none && right_none);
+            else if(!equal(*left, *right, result))
+                return node;
+
+            if(op == CompareOpType::NotEqual)
+                result = !result;
+            break;
+        case CompareOpType::Less:
+        case CompareOpType::LessEqual:
+        case CompareOpType::More:
+        case CompareOpType::MoreEqual:
+        {
+            if(left->type != NodeType::Integer || right->type != NodeType::Integer)
+                return node;
+
+            auto l = left->integer;
+            auto r = right->integer;
+
+            result = (op == CompareOpType::Less) ? l < r
+                   : (op == CompareOpType::LessEqual) ? l <= r
+                   : (op == CompareOpType::More) ? l > r : l >= r;
+            break;
+        }
+        case CompareOpType::In:
+        case CompareOpType::NotIn:
+            if(!contains(*right, *left, result))
+                return node;
+
+            if(op == CompareOpType::NotIn)
+                result = !result;
+            break;
+        default:
+            return node;
+        }
+
+        return make_bool(result);
+    }
+
+    NodePtr fold_bool_op(const NodePtr &node) const
+    {
+        auto op = static_cast<BoolOpType>(node->op);
+
+        if(op != BoolOpType::And && op != BoolOpType::Or)
+            return node;
+
+        // The value that decides the result, e.g. False for and
+        bool decisive = (op == BoolOpType::Or);
+        std::vector<NodePtr> operands;
+
+        for(auto &child: node->children)
+        {
+            bool value;
+
+            if(!bool_literal(*child, value))
+            {
+                operands.push_back(child);
+                continue;
+            }
+
+            if(value != decisive)
+                continue;
+
+            // Operands before it still run, as they might raise errors
+            if(operands.empty())
+                return make_bool(decisive);
+
+            operands.push_back(child);
+            break;
+        }
+
+        if(operands.empty())
+            return make_bool(!decisive);
+
+        // Other operands are checked to be booleans by the operation
+        if(operands.size() == 1 && (operands[0]->type == NodeType::Compare || operands[0]->type == NodeType::BoolOp))
+            return operands[0];
+
+        node->children = operands;
+        return node;
+    }
+
+    const std::map<std::string, NodePtr> &m_known;
+    const Bindings &m_bindings;
+
+    Node m_none = *make_node(NodeType::Name, "None");
+};
+
+static void collect_names(const Node &node, std::set<std::string> &names)
+{
+    if(node.type == NodeType::Name)
+        names.insert(node.name);
+
+    for(auto &child: node.children)
+        collect_names(*child, names);
+}
+
+PartialEvaluator::PartialEvaluator(const BitStream &program)
+{
+    m_program.assign(program.data(), program.size(), true);
+}
+
+void PartialEvaluator::set_value(const std::string &name, const ValuePtr &value)
+{
+    m_known[name] = make_literal(value);
+}
+
+void PartialEvaluator::set_string(const std::string &name, const std::string &value)
+{
+    m_known[name] = make_node(NodeType::String, value);
+}
+
+void PartialEvaluator::set_list(const std::string &name, const std::vector<std::string> &list)
+{
+    auto node = make_node(NodeType::List);
+
+    for(auto &str: list)
+        node->children.push_back(make_node(NodeType::String, str));
+
+    m_known[name] = node;
+}
+
+void PartialEvaluator::set_set(const std::string &name, const std::vector<std::string> &elements)
+{
+    set_list(name, elements);
+    m_known[name]->type = NodeType::Set;
+}
+
+BitStream PartialEvaluator::specialize() const
+{
+    auto program = decode_program(m_program);
+    auto bindings = analyze_bindings(*program);
+
+    Specializer specializer(m_known, bindings);
+    program = specializer.visit(program);
+
+    if(!program)
+        program = make_node(NodeType::StatementList);
+
+    std::set<std::string> names;
+    collect_names(*program, names);
+
+    std::vector<NodePtr> assignments;
+
+    for(auto &it: m_known)
+    {
+        if(!names.count(it.first))
+            continue;
+
+        auto assign = make_node(NodeType::Assign);
+        assign->children.push_back(copy_tree(*it.second));
+        assign->children.push_back(make_node(NodeType::Name, it.first));
+        assignments.push_back(assign);
+    }
+
+    if(!assignments.empty())
+    {
+        if(program->type != NodeType::StatementList)
+        {
+            auto list = make_node(NodeType::StatementList);
+            list->children.push_back(program);
+            program = list;
+        }
+
+        program->children.insert(program->children.begin(), assignments.begin(), assignments.end());
+    }
+
+    return encode_program(*program);
+}
+
+}
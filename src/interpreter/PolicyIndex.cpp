@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <limits>
+#include <map>
+
+#include "chipy/PolicyIndex.h"
+#include "Operators.h"
+#include "SyntaxTree.h"
+
+namespace chipy
+{
+
+class GuardAnalyzer
+{
+public:
+    GuardAnalyzer(const std::string &input_name)
+        : m_input_name(input_name)
+    {}
+
+    PolicyGuards analyze(const Node &program)
+    {
+        PolicyGuards result;
+
+        std::vector<const Node*> statements;
+
+        if(program.type == NodeType::StatementList)
+        {
+            for(auto &child: program.children)
+                statements.push_back(child.get());
+        }
+        else
+            statements.push_back(&program);
+
+        // Modules are loaded before the program runs
+        size_t pos = 0;
+        while(pos < statements.size() && (statements[pos]->type == NodeType::Import || statements[pos]->type == NodeType::ImportFrom))
+        {
+            auto &alias = *statements[pos]->children.back();
+            if(alias.name == m_input_name || alias.as_name == m_input_name)
+                return result;
+
+            pos += 1;
+        }
+
+        if(pos >= statements.size())
+            return result;
+
+        auto &statement = *statements[pos];
+
+        switch(statement.type)
+        {
+        case NodeType::Return:
+            // A failed test short-circuits `and` to False
+            result.default_result = false;
+            collect(*statement.children[0], result.guards);
+            break;
+        case NodeType::If:
+        {
+            if(pos + 1 >= statements.size() || !constant_return(*statements[pos+1], result.default_result))
+                return result;
+
+            collect(*statement.children[0], result.guards);
+            break;
+        }
+        case NodeType::IfElse:
+        {
+            if(!constant_return(*statement.children[2], result.default_result))
+                return result;
+
+            collect(*statement.children[0], result.guards);
+            break;
+        }
+        default:
+            break;
+        }
+
+        return result;
+    }
+
+private:
+    // Adds the equality tests at the start of condition
+    // Returns false once something else is found, as that might be evaluated
+    // before the tests that follow it
+    bool collect(const Node &condition, std::vector<Guard> &guards) const
+    {
+        if(condition.type == NodeType::BoolOp && static_cast<BoolOpType>(condition.op) == BoolOpType::And)
+        {
+            for(auto &child: condition.children)
+            {
+                if(!collect(*child, guards))
+                    return false;
+            }
+
+            return true;
+        }
+
+        Guard guard;
+
+        if(!guard_of(condition, guard))
+            return false;
+
+        guards.push_back(guard);
+        return true;
+    }
+
+    bool guard_of(const Node &node, Guard &guard) const
+    {
+        if(node.type != NodeType::Compare || node.ops.size() != 1
+           || static_cast<CompareOpType>(node.ops[0]) != CompareOpType::Equals)
+            return false;
+
+        auto path = node.children[0].get();
+        auto constant = node.children[1].get();
+
+        if(constant->type != NodeType::Integer && constant->type != NodeType::String)
+            std::swap(path, constant);
+
+        if(!path_of(*path, guard.path))
+            return false;
+
+        if(constant->type == NodeType::String)
+        {
+            guard.is_string = true;
+            guard.string_value = constant->name;
+            guard.integer_value = 0;
+        }
+        else if(constant->type == NodeType::Integer)
+        {
+            guard.is_string = false;
+            guard.integer_value = constant->integer;
+        }
+        else
+            return false;
+
+        return true;
+    }
+
+    bool path_of(const Node &node, InputPath &path) const
+    {
+        if(node.type == NodeType::Name)
+        {
+            if(node.name != m_input_name)
+                return false;
+
+            path.push_back(node.name);
+            return true;
+        }
+
+        if(node.type != NodeType::Subscript)
+            return false;
+
+        auto &slice = *node.children[0];
+
+        if(slice.type != NodeType::Index || slice.children[0]->type != NodeType::String)
+            return false;
+
+        // Keys with dots cannot be looked up as document paths
+        auto &key = slice.children[0]->name;
+        if(key.find('.') != std::string::npos)
+            return false;
+
+        if(!path_of(*node.children[1], path))
+            return false;
+
+        path.push_back(key);
+        return true;
+    }
+
+    bool constant_return(const Node &node, bool &value) const
+    {
+        if(node.type == NodeType::StatementList)
+            return !node.children.empty() && constant_return(*node.children[0], value);
+
+        if(node.type != NodeType::Return)
+            return false;
+
+        auto &result = *node.children[0];
+
+        if(result.type != NodeType::Name || (result.name != "True" && result.name != "False"))
+            return false;
+
+        value = (result.name == "True");
+        return true;
+    }
+
+    const std::string &m_input_name;
+};
+
+PolicyGuards analyze_guards(const BitStream &program, const std::string &input_name)
+{
+    auto tree = decode_program(program);
+
+    GuardAnalyzer analyzer(input_name);
+    return analyzer.analyze(*tree);
+}
+
+static std::string guard_key(const Guard &guard)
+{
+    if(guard.is_string)
+        return "s" + guard.string_value;
+    else
+        return "i" + std::to_string(guard.integer_value);
+}
+
+static void append_key(std::string &key, const std::string &part)
+{
+    key += std::to_string(part.size());
+    key += ':';
+    key += part;
+}
+
+// Returns false if the input does not decide how a guard on path evaluates,
+// e.g. because the path is missing and the program would raise an error
+static bool input_key(const json::Document &doc, const InputPath &path, std::string &key)
+{
+    std::string doc_path;
+
+    for(size_t i = 1; i < path.size(); ++i)
+    {
+        if(i > 1)
+            doc_path += '.';
+
+        doc_path += path[i];
+    }
+
+    json::Document value = doc_path.empty() ? doc : json::Document(doc, doc_path, false);
+
+    if(value.empty())
+        return false;
+
+    switch(value.get_type())
+    {
+    case json::ObjectType::String:
+        key = "s" + value.as_string();
+        return true;
+    case json::ObjectType::Integer:
+    {
+        auto i = value.as_integer();
+
+        if(i < std::numeric_limits<int32_t>::min() || i > std::numeric_limits<int32_t>::max())
+            return false;
+
+        key = "i" + std::to_string(i);
+        return true;
+    }
+    case json::ObjectType::Float:
+    {
+        // Floats compare equal to integers of the same value
+        int32_t i;
+
+        if(integer_value(value.as_float(), i))
+            key = "i" + std::to_string(i);
+        else
+            key = "f";
+        return true;
+    }
+    case json::ObjectType::Boolean:
+    case json::ObjectType::Map:
+    case json::ObjectType::Array:
+        // Never equal to a string or integer constant
+        key = "x";
+        return true;
+    default:
+        return false;
+    }
+}
+
+PolicyIndex::PolicyIndex(const std::vector<BitStream> &programs, const std::string &input_name)
+    : m_policies(programs, input_name)
+{
+    std::map<InputPath, size_t> paths;
+    std::map<std::vector<size_t>, size_t> groups;
+
+    for(size_t i = 0; i < programs.size(); ++i)
+    {
+        auto guards = analyze_guards(programs[i], input_name);
+        m_defaults.push_back(guards.default_result);
+
+        if(guards.guards.empty())
+        {
+            m_unindexed.push_back(i);
+            continue;
+        }
+
+        // Only the first test of a path is used; running a program whose
+        // other tests fail is correct, just not necessary
+        std::map<size_t, std::string> values;
+
+        for(auto &guard: guards.guards)
+        {
+            auto it = paths.find(guard.path);
+
+            if(it == paths.end())
+            {
+                it = paths.emplace(guard.path, m_paths.size()).first;
+                m_paths.push_back(guard.path);
+            }
+
+            values.emplace(it->second, guard_key(guard));
+        }
+
+        std::vector<size_t> group_paths;
+        std::string key;
+
+        for(auto &it: values)
+        {
+            group_paths.push_back(it.first);
+            append_key(key, it.second);
+        }
+
+        auto it = groups.find(group_paths);
+
+        if(it == groups.end())
+        {
+            it = groups.emplace(group_paths, m_groups.size()).first;
+            m_groups.push_back(Group());
+            m_groups.back().paths = group_paths;
+        }
+
+        auto &group = m_groups[it->second];
+        group.policies[key].push_back(i);
+        group.all.push_back(i);
+    }
+}
+
+std::vector<size_t> PolicyIndex::candidates(const json::Document &doc) const
+{
+    std::vector<std::string> keys(m_paths.size());
+    std::vector<uint8_t> decided(m_paths.size());
+
+    for(size_t i = 0; i < m_paths.size(); ++i)
+        decided[i] = input_key(doc, m_paths[i], keys[i]);
+
+    std::vector<size_t> result = m_unindexed;
+
+    for(auto &group: m_groups)
+    {
+        std::string key;
+        bool all_decided = true;
+
+        for(auto path: group.paths)
+        {
+            if(!decided[path])
+            {
+                all_decided = false;
+                break;
+            }
+
+            append_key(key, keys[path]);
+        }
+
+        if(!all_decided)
+        {
+            result.insert(result.end(), group.all.begin(), group.all.end());
+            continue;
+        }
+
+        auto it = group.policies.find(key);
+
+        if(it != group.policies.end())
+            result.insert(result.end(), it->second.begin(), it->second.end());
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<bool> PolicyIndex::evaluate(const json::Document &doc)
+{
+    auto results = m_defaults;
+    m_policies.evaluate(doc, candidates(doc), results);
+    return results;
+}
+
+}
@@ -0,0 +1,201 @@
+#include "chipy/PolicySet.h"
+#include "SyntaxTree.h"
+
+namespace chipy
+{
+
+struct Occurrence
+{
+    size_t policy;
+    uint32_t position;
+};
+
+// Finds the expressions of a program that only depend on its input
+// Identical expressions have identical encodings, so these are used as keys
+class PureExpressionFinder
+{
+public:
+    PureExpressionFinder(const BitStream &program, size_t policy, const std::string &input_name,
+                         std::map<std::string, std::vector<Occurrence>> &expressions)
+        : m_program(program), m_policy(policy), m_input_name(input_name), m_expressions(expressions)
+    {}
+
+    bool visit(const Node &node)
+    {
+        bool pure = true;
+
+        for(auto &child: node.children)
+        {
+            if(!visit(*child))
+                pure = false;
+        }
+
+        switch(node.type)
+        {
+        case NodeType::Integer:
+        case NodeType::String:
+        case NodeType::ConstantSet:
+            return true;
+        case NodeType::Name:
+            // Other globals might be set differently for each program
+            return node.name == m_input_name || node.name == "True" || node.name == "False"
+                || node.name == "None";
+        case NodeType::Index:
+        case NodeType::Subscript:
+        case NodeType::BinaryOp:
+        case NodeType::List:
+        case NodeType::Tuple:
+        case NodeType::Set:
+        case NodeType::Dictionary:
+            return pure;
+        case NodeType::Compare:
+        case NodeType::BoolOp:
+        case NodeType::UnaryOp:
+        {
+            // Only these are shared, as their results are immutable
+            if(pure)
+            {
+                std::string key(reinterpret_cast<const char*>(m_program.data()) + node.position,
+                                node.end - node.position);
+                m_expressions[key].push_back(Occurrence{m_policy, node.position});
+            }
+
+            return pure;
+        }
+        default:
+            return false;
+        }
+    }
+
+private:
+    const BitStream &m_program;
+    const size_t m_policy;
+    const std::string &m_input_name;
+    std::map<std::string, std::vector<Occurrence>> &m_expressions;
+};
+
+PolicySet::PolicySet(const std::vector<BitStream> &programs, const std::string &input_name)
+    : m_input_name(input_name)
+{
+    std::map<std::string, std::vector<Occurrence>> expressions;
+
+    for(size_t i = 0; i < programs.size(); ++i)
+    {
+        auto &program = programs[i];
+        auto tree = decode_program(program);
+
+        auto bindings = analyze_bindings(*tree);
+
+        Policy policy;
+        policy.interpreter.reset(new Interpreter(program));
+        policy.interpreter->prepare();
+        policy.isolated = bindings.mutates || bindings.names.count(input_name);
+        policy.inputs = analyze_inputs(program);
+
+        if(!policy.isolated)
+        {
+            for(auto &path: policy.inputs.paths())
+                m_inputs.add(path);
+
+            PureExpressionFinder finder(program, i, input_name, expressions);
+            finder.visit(*tree);
+        }
+
+        m_policies.push_back(std::move(policy));
+        m_all.push_back(i);
+    }
+
+    std::vector<std::map<uint32_t, uint32_t>> slots(m_policies.size());
+
+    for(auto &it: expressions)
+    {
+        if(it.second.size() < 2)
+            continue;
+
+        uint32_t index = m_shared_values.size();
+        m_shared_values.emplace_back();
+
+        for(auto &occurrence: it.second)
+            slots[occurrence.policy][occurrence.position] = index;
+    }
+
+    for(size_t i = 0; i < m_policies.size(); ++i)
+    {
+        if(!slots[i].empty())
+            m_policies[i].interpreter->set_shared_values(slots[i], &m_shared_values);
+    }
+}
+
+void PolicySet::run(const json::Document &doc, const std::vector<size_t> &indices, std::vector<bool> &results)
+{
+    ValuePtr input;
+
+    for(auto i: indices)
+    {
+        auto &policy = m_policies[i];
+
+        if(policy.isolated)
+            policy.interpreter->set_document(m_input_name, doc, policy.inputs);
+        else
+        {
+            if(!input)
+                input = m_inputs.project(m_mem, m_input_name, doc);
+
+            policy.interpreter->set_value(m_input_name, input);
+        }
+
+        results[i] = policy.interpreter->execute();
+    }
+}
+
+bool PolicySet::release(const std::vector<size_t> &indices)
+{
+    // Shared values may live in any of the interpreters' memory
+    for(auto &value: m_shared_values)
+        value.reset();
+
+    bool released = true;
+
+    for(auto i: indices)
+    {
+        auto &policy = m_policies[i];
+
+        policy.interpreter->reset();
+        released = policy.record.release(policy.interpreter->memory_manager()) && released;
+    }
+
+    return m_record.release(m_mem) && released;
+}
+
+std::vector<bool> PolicySet::evaluate(const json::Document &doc)
+{
+    std::vector<bool> results(m_policies.size());
+    evaluate(doc, m_all, results);
+    return results;
+}
+
+void PolicySet::evaluate(const json::Document &doc, const std::vector<size_t> &indices, std::vector<bool> &results)
+{
+    for(auto i: indices)
+    {
+        auto &policy = m_policies[i];
+        policy.record.begin(policy.interpreter->memory_manager());
+    }
+
+    m_record.begin(m_mem);
+
+    try
+    {
+        run(doc, indices, results);
+    }
+    catch(...)
+    {
+        release(indices);
+        throw;
+    }
+
+    if(!release(indices))
+        throw std::runtime_error("An input left values alive");
+}
+
+}
@@ -20,19 +20,19 @@ public:
         return wrap_value(new (memory_manager()) RangeIterator(memory_manager(), m_start, m_end, m_step_size));
     }
 
-    ValuePtr next() override
+    bool next(ValuePtr &out) override
     {
-        if(m_pos >= m_end)
-            throw stop_iteration_exception();
+        if(m_step_size > 0 ? m_pos >= m_end : m_pos <= m_end)
+            return false;
 
-        auto res = wrap_value(new (memory_manager()) IntVal(memory_manager(), m_pos));
+        out = wrap_value(new (memory_manager()) IntVal(memory_manager(), m_pos));
         m_pos += m_step_size;
 
-        return res;
+        return true;
     }
 
 private:
-    int32_t m_pos;
+    int64_t m_pos;
     const int32_t m_start, m_end, m_step_size;
 };
 
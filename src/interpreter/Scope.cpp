@@ -6,6 +6,27 @@
 namespace chipy
 {
 
+const std::string Scope::BUILTIN_STR_NONE = "None";
+const std::string Scope::BUILTIN_STR_RANGE = "range";
+const std::string Scope::BUILTIN_STR_MAKE_INT = "int";
+const std::string Scope::BUILTIN_STR_MAKE_STR = "str";
+const std::string Scope::BUILTIN_STR_PRINT = "print";
+const std::string Scope::BUILTIN_STR_MAKE_SET = "set";
+
+Scope::Scope(MemoryManager &mem)
+    : Object(mem), m_parent(nullptr)
+{
+    auto add_builtin = [&](const std::string &name, BuiltinType type) {
+        m_builtins[name] = wrap_value(new (mem) Builtin(mem, type));
+    };
+
+    add_builtin(BUILTIN_STR_RANGE, BuiltinType::Range);
+    add_builtin(BUILTIN_STR_MAKE_INT, BuiltinType::MakeInt);
+    add_builtin(BUILTIN_STR_MAKE_STR, BuiltinType::MakeString);
+    add_builtin(BUILTIN_STR_PRINT, BuiltinType::Print);
+    add_builtin(BUILTIN_STR_MAKE_SET, BuiltinType::MakeSet);
+}
+
 void Scope::set_value(const std::string &id, ValuePtr value)
 {
     if(m_parent && m_parent->has_value(id))
@@ -14,13 +35,6 @@ void Scope::set_value(const std::string &id, ValuePtr value)
         return;
     }
 
-    // FIXME actually update references...
-    auto it = m_values.find(id);
-    if(it != m_values.end())
-    {
-        m_values.erase(it);
-    }
-
     m_values[id] = value;
 }
 
@@ -32,39 +46,48 @@ bool Scope::has_value(const std::string &id) const
     return m_values.find(id) != m_values.end();
 }
 
-ValuePtr Scope::get_value(const std::string &id)
+bool Scope::is_builtin_name(const std::string &id)
 {
-    Value* val = nullptr;
+    return id == BUILTIN_STR_NONE || id == BUILTIN_STR_RANGE || id == BUILTIN_STR_MAKE_INT
+        || id == BUILTIN_STR_MAKE_STR || id == BUILTIN_STR_PRINT || id == BUILTIN_STR_MAKE_SET;
+}
 
+ValuePtr Scope::get_value(const std::string &id)
+{
     if(id == BUILTIN_STR_NONE)
         return std::shared_ptr<Value>{nullptr};
-    else if(id == BUILTIN_STR_RANGE)
-        val = new (memory_manager()) Builtin(memory_manager(), BuiltinType::Range);
-    else if(id == BUILTIN_STR_MAKE_INT)
-        val = new (memory_manager()) Builtin(memory_manager(), BuiltinType::MakeInt);
-    else if(id == BUILTIN_STR_MAKE_STR)
-        val = new (memory_manager()) Builtin(memory_manager(), BuiltinType::MakeString);
-    else if(id == BUILTIN_STR_PRINT)
-        val = new (memory_manager()) Builtin(memory_manager(), BuiltinType::Print);
-
-    if(val)
-        return std::shared_ptr<Value>(val);
-
-    auto it = m_values.find(id);
-    if(it == m_values.end())
+
+    for(auto scope = this; scope; scope = scope->m_parent)
     {
-        if(m_parent)
-            return m_parent->get_value(id);
-        else
-            throw std::runtime_error("No such value: " + id);
+        auto it = scope->m_values.find(id);
+        if(it != scope->m_values.end())
+            return it->second;
+
+        // Only the global scope holds the builtins
+        if(!scope->m_parent)
+        {
+            auto builtin = scope->m_builtins.find(id);
+            if(builtin != scope->m_builtins.end())
+                return builtin->second;
+        }
     }
 
-    return it->second;
+    throw std::runtime_error("No such value: " + id);
 }
 
 void Scope::terminate()
 {
+    // A return ends the program, not just the innermost block
     m_terminated = true;
+
+    if(m_parent)
+        m_parent->terminate();
+}
+
+void Scope::clear()
+{
+    m_values.clear();
+    m_terminated = false;
 }
 
 bool Scope::is_terminated() const
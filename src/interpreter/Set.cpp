@@ -0,0 +1,309 @@
+#include <functional>
+
+#if defined(__SSE2__) && !defined(IS_ENCLAVE)
+#include <emmintrin.h>
+#define CHIPY_SET_SIMD
+#endif
+
+#include "chipy/Set.h"
+
+namespace chipy
+{
+
+constexpr uint32_t IntTable::GROUP_SIZE;
+constexpr int32_t IntTable::EMPTY;
+constexpr uint32_t StringTable::GROUP_SIZE;
+
+static uint32_t hash_integer(int32_t value)
+{
+    // Fibonacci hashing; the high bits are mixed down, as groups use the low ones
+    uint32_t h = static_cast<uint32_t>(value) * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+bool IntTable::insert(int32_t value)
+{
+    if(value == EMPTY)
+    {
+        if(m_has_empty)
+            return false;
+
+        m_has_empty = true;
+        return true;
+    }
+
+    // At most three quarters full, so every probe ends at an unused slot
+    if((m_size + 1) * 4 > m_slots.size() * 3)
+        grow();
+
+    uint32_t mask = m_slots.size() / GROUP_SIZE - 1;
+
+    // There are no deletes, so the value would be before the first unused slot
+    for(uint32_t group = hash_integer(value) & mask;; group = (group + 1) & mask)
+    {
+        auto slots = &m_slots[group * GROUP_SIZE];
+
+        for(uint32_t i = 0; i < GROUP_SIZE; ++i)
+        {
+            if(slots[i] == value)
+                return false;
+
+            if(slots[i] == EMPTY)
+            {
+                slots[i] = value;
+                m_size += 1;
+                return true;
+            }
+        }
+    }
+}
+
+bool IntTable::contains(int32_t value) const
+{
+    if(value == EMPTY)
+        return m_has_empty;
+
+    if(m_slots.empty())
+        return false;
+
+    uint32_t mask = m_slots.size() / GROUP_SIZE - 1;
+
+#ifdef CHIPY_SET_SIMD
+    const __m128i probe = _mm_set1_epi32(value);
+    const __m128i empty = _mm_set1_epi32(EMPTY);
+#endif
+
+    for(uint32_t group = hash_integer(value) & mask;; group = (group + 1) & mask)
+    {
+        auto slots = &m_slots[group * GROUP_SIZE];
+
+#ifdef CHIPY_SET_SIMD
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots));
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(block, probe)))
+            return true;
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(block, empty)))
+            return false;
+#else
+        for(uint32_t i = 0; i < GROUP_SIZE; ++i)
+        {
+            if(slots[i] == value)
+                return true;
+
+            if(slots[i] == EMPTY)
+                return false;
+        }
+#endif
+    }
+}
+
+void IntTable::grow()
+{
+    std::vector<int32_t> old;
+    old.swap(m_slots);
+
+    m_slots.assign(old.empty() ? 4 * GROUP_SIZE : old.size() * 2, EMPTY);
+    m_size = 0;
+
+    for(auto value: old)
+    {
+        if(value != EMPTY)
+            insert(value);
+    }
+}
+
+static uint8_t string_tag(size_t hash)
+{
+    // The low bits pick the group, so the tag uses the high ones
+    return 0x80 | static_cast<uint8_t>(hash >> (sizeof(size_t) * 8 - 7));
+}
+
+bool StringTable::insert(const std::string &value)
+{
+    // At most seven eighths full, so every probe ends at an unused slot
+    if((m_size + 1) * 8 > m_slots.size() * 7)
+        grow();
+
+    auto hash = std::hash<std::string>()(value);
+    auto tag = string_tag(hash);
+    size_t mask = m_slots.size() / GROUP_SIZE - 1;
+
+    for(size_t group = hash & mask;; group = (group + 1) & mask)
+    {
+        for(size_t i = group * GROUP_SIZE; i < (group + 1) * GROUP_SIZE; ++i)
+        {
+            if(m_tags[i] == tag && m_slots[i] == value)
+                return false;
+
+            if(m_tags[i] == 0)
+            {
+                m_tags[i] = tag;
+                m_slots[i] = value;
+                m_size += 1;
+                return true;
+            }
+        }
+    }
+}
+
+bool StringTable::contains(const std::string &value) const
+{
+    if(m_slots.empty())
+        return false;
+
+    auto hash = std::hash<std::string>()(value);
+    auto tag = string_tag(hash);
+    size_t mask = m_slots.size() / GROUP_SIZE - 1;
+
+#ifdef CHIPY_SET_SIMD
+    const __m128i probe = _mm_set1_epi8(static_cast<char>(tag));
+    const __m128i empty = _mm_setzero_si128();
+#endif
+
+    for(size_t group = hash & mask;; group = (group + 1) & mask)
+    {
+        auto first = group * GROUP_SIZE;
+
+#ifdef CHIPY_SET_SIMD
+        auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_tags[first]));
+
+        for(int matches = _mm_movemask_epi8(_mm_cmpeq_epi8(block, probe)); matches; matches &= matches - 1)
+        {
+            if(m_slots[first + __builtin_ctz(matches)] == value)
+                return true;
+        }
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(block, empty)))
+            return false;
+#else
+        for(size_t i = first; i < first + GROUP_SIZE; ++i)
+        {
+            if(m_tags[i] == tag && m_slots[i] == value)
+                return true;
+
+            if(m_tags[i] == 0)
+                return false;
+        }
+#endif
+    }
+}
+
+void StringTable::grow()
+{
+    std::vector<uint8_t> old_tags;
+    std::vector<std::string> old_slots;
+    old_tags.swap(m_tags);
+    old_slots.swap(m_slots);
+
+    auto size = old_slots.empty() ? GROUP_SIZE : old_slots.size() * 2;
+    m_tags.assign(size, 0);
+    m_slots.resize(size);
+    m_size = 0;
+
+    for(size_t i = 0; i < old_slots.size(); ++i)
+    {
+        if(old_tags[i] != 0)
+            insert(old_slots[i]);
+    }
+}
+
+IteratorPtr Set::iterate()
+{
+    return wrap_value(new (memory_manager()) SetIterator(memory_manager(), *this));
+}
+
+ValuePtr Set::duplicate()
+{
+    auto s = wrap_value(new (memory_manager()) Set(memory_manager()));
+
+    for(auto &elem: m_elements)
+    {
+        s->insert(elem);
+    }
+
+    return s;
+}
+
+ValueType Set::type() const
+{
+    return ValueType::Set;
+}
+
+uint32_t Set::size() const
+{
+    return m_elements.size();
+}
+
+bool Set::insert(ValuePtr value)
+{
+    if(value && value->type() == ValueType::Integer)
+    {
+        if(!m_integers.insert(value_cast<IntVal>(value)->get()))
+            return false;
+    }
+    else if(value && value->type() == ValueType::String)
+    {
+        if(!m_strings.insert(value_cast<StringVal>(value)->get()))
+            return false;
+    }
+    else
+        throw std::runtime_error("Sets can only hold integers and strings");
+
+    m_elements.push_back(value);
+    return true;
+}
+
+bool Set::contains(const Value &value) const
+{
+    // type() identifies the class, see Value.h
+    if(value.type() == ValueType::Integer)
+        return contains(static_cast<const IntVal&>(value).get());
+    else if(value.type() == ValueType::String)
+        return contains(static_cast<const StringVal&>(value).get());
+    else if(value.type() == ValueType::Float)
+    {
+        int32_t i;
+        return integer_value(static_cast<const FloatVal&>(value).get(), i) && contains(i);
+    }
+    else
+        return false;
+}
+
+bool Set::contains(int32_t value) const
+{
+    return m_integers.contains(value);
+}
+
+bool Set::contains(const std::string &value) const
+{
+    return m_strings.contains(value);
+}
+
+const std::vector<ValuePtr>& Set::elements() const
+{
+    return m_elements;
+}
+
+SetIterator::SetIterator(MemoryManager &mem, Set &set)
+    : Generator(mem), m_set(set), m_pos(0)
+{
+}
+
+bool SetIterator::next(ValuePtr &out)
+{
+    if(m_pos >= m_set.size())
+        return false;
+
+    out = m_set.elements()[m_pos];
+    m_pos += 1;
+
+    return true;
+}
+
+ValuePtr SetIterator::duplicate()
+{
+    return wrap_value(new (memory_manager()) SetIterator(memory_manager(), m_set));
+}
+
+}
@@ -0,0 +1,407 @@
+#include <stdexcept>
+
+#include "SyntaxTree.h"
+
+namespace chipy
+{
+
+class Decoder
+{
+public:
+    Decoder(const BitStream &data)
+    {
+        m_data.assign(data.data(), data.size(), false);
+    }
+
+    NodePtr decode_next()
+    {
+        NodePtr node(new Node());
+        node->position = m_data.pos();
+        m_data >> node->type;
+
+        switch(node->type)
+        {
+        case NodeType::Name:
+        case NodeType::String:
+            m_data >> node->name;
+            break;
+        case NodeType::Integer:
+            m_data >> node->integer;
+            break;
+        case NodeType::Alias:
+            m_data >> node->name >> node->as_name;
+            break;
+        case NodeType::Break:
+        case NodeType::Continue:
+            break;
+        case NodeType::Import:
+        case NodeType::Index:
+        case NodeType::Return:
+            decode_children(*node, 1);
+            break;
+        case NodeType::Attribute:
+        case NodeType::ImportFrom:
+        case NodeType::If:
+        case NodeType::Subscript:
+        case NodeType::WhileLoop:
+            decode_children(*node, 2);
+            break;
+        case NodeType::IfElse:
+        case NodeType::ForLoop:
+            decode_children(*node, 3);
+            break;
+        case NodeType::StatementList:
+        case NodeType::List:
+        case NodeType::Set:
+        case NodeType::Tuple:
+            decode_children(*node, read_size());
+            break;
+        case NodeType::Dictionary:
+            decode_children(*node, 2 * read_size());
+            break;
+        case NodeType::Assign:
+        case NodeType::Call:
+            decode_children(*node, 1);
+            decode_children(*node, read_size());
+            break;
+        case NodeType::UnaryOp:
+            m_data >> node->op;
+            decode_children(*node, 1);
+            break;
+        case NodeType::BinaryOp:
+        case NodeType::AugmentedAssign:
+            m_data >> node->op;
+            decode_children(*node, 2);
+            break;
+        case NodeType::BoolOp:
+            m_data >> node->op;
+            decode_children(*node, read_size());
+            break;
+        case NodeType::Compare:
+        {
+            decode_children(*node, 1);
+            auto size = read_size();
+
+            for(uint32_t i = 0; i < size; ++i)
+            {
+                uint32_t op = 0;
+                m_data >> op;
+                node->ops.push_back(op);
+                decode_children(*node, 1);
+            }
+            break;
+        }
+        case NodeType::ConstantSet:
+        {
+            auto num_integers = read_size();
+            node->integers.resize(num_integers);
+            for(auto &i: node->integers)
+                m_data >> i;
+
+            auto num_strings = read_size();
+            node->strings.resize(num_strings);
+            for(auto &str: node->strings)
+                m_data >> str;
+            break;
+        }
+        case NodeType::RangeLoop:
+            m_data >> node->name;
+            decode_children(*node, read_size() + 1);
+            break;
+        case NodeType::ItemsLoop:
+            m_data >> node->name >> node->as_name;
+            decode_children(*node, 2);
+            break;
+        case NodeType::CachedValue:
+            m_data >> node->slot;
+            decode_children(*node, 1);
+            break;
+        case NodeType::ClearCache:
+            m_data >> node->slot >> node->integer;
+            decode_children(*node, 1);
+            break;
+        case NodeType::IntegerBinaryOp:
+            node->specialized = true;
+            node->specialization = node->type;
+            node->type = NodeType::BinaryOp;
+            m_data >> node->op;
+            decode_children(*node, 2);
+            break;
+        case NodeType::IntegerCompare:
+        case NodeType::StringCompare:
+        {
+            node->specialized = true;
+            node->specialization = node->type;
+            node->type = NodeType::Compare;
+            decode_children(*node, 1);
+
+            uint32_t op = 0;
+            m_data >> op;
+            node->ops.push_back(op);
+            decode_children(*node, 1);
+            break;
+        }
+        default:
+            throw std::runtime_error("Failed to decode unknown node type!");
+        }
+
+        node->end = m_data.pos();
+        return node;
+    }
+
+private:
+    uint32_t read_size()
+    {
+        uint32_t size = 0;
+        m_data >> size;
+        return size;
+    }
+
+    void decode_children(Node &node, uint32_t count)
+    {
+        for(uint32_t i = 0; i < count; ++i)
+            node.children.push_back(decode_next());
+    }
+
+    BitStream m_data;
+};
+
+NodePtr decode_program(const BitStream &data)
+{
+    Decoder decoder(data);
+    return decoder.decode_next();
+}
+
+class Encoder
+{
+public:
+    void encode_next(const Node &node)
+    {
+        auto &children = node.children;
+
+        // A specialized Compare only supports a single comparison
+        bool specialized = node.specialized && (node.type == NodeType::BinaryOp || node.ops.size() == 1);
+        m_result << (specialized ? node.specialization : node.type);
+
+        switch(node.type)
+        {
+        case NodeType::Name:
+        case NodeType::String:
+            m_result << node.name;
+            break;
+        case NodeType::Integer:
+            m_result << node.integer;
+            break;
+        case NodeType::Alias:
+            m_result << node.name << node.as_name;
+            break;
+        case NodeType::Break:
+        case NodeType::Continue:
+            break;
+        case NodeType::Import:
+        case NodeType::Index:
+        case NodeType::Return:
+        case NodeType::Attribute:
+        case NodeType::ImportFrom:
+        case NodeType::If:
+        case NodeType::Subscript:
+        case NodeType::WhileLoop:
+        case NodeType::IfElse:
+        case NodeType::ForLoop:
+            encode_children(node, 0);
+            break;
+        case NodeType::StatementList:
+        case NodeType::List:
+        case NodeType::Set:
+        case NodeType::Tuple:
+            write_size(children.size());
+            encode_children(node, 0);
+            break;
+        case NodeType::Dictionary:
+            write_size(children.size() / 2);
+            encode_children(node, 0);
+            break;
+        case NodeType::Assign:
+        case NodeType::Call:
+            encode_next(*children[0]);
+            write_size(children.size() - 1);
+            encode_children(node, 1);
+            break;
+        case NodeType::UnaryOp:
+        case NodeType::BinaryOp:
+        case NodeType::AugmentedAssign:
+            m_result << node.op;
+            encode_children(node, 0);
+            break;
+        case NodeType::BoolOp:
+            m_result << node.op;
+            write_size(children.size());
+            encode_children(node, 0);
+            break;
+        case NodeType::Compare:
+            encode_next(*children[0]);
+
+            if(specialized)
+            {
+                m_result << node.ops[0];
+                encode_next(*children[1]);
+                break;
+            }
+
+            write_size(node.ops.size());
+
+            for(size_t i = 0; i < node.ops.size(); ++i)
+            {
+                m_result << node.ops[i];
+                encode_next(*children[i+1]);
+            }
+            break;
+        case NodeType::ConstantSet:
+            write_size(node.integers.size());
+            for(auto i: node.integers)
+                m_result << i;
+
+            write_size(node.strings.size());
+            for(auto &str: node.strings)
+                m_result << str;
+            break;
+        case NodeType::RangeLoop:
+            m_result << node.name;
+            write_size(children.size() - 1);
+            encode_children(node, 0);
+            break;
+        case NodeType::ItemsLoop:
+            m_result << node.name << node.as_name;
+            encode_children(node, 0);
+            break;
+        case NodeType::CachedValue:
+            m_result << node.slot;
+            encode_children(node, 0);
+            break;
+        case NodeType::ClearCache:
+            m_result << node.slot << node.integer;
+            encode_children(node, 0);
+            break;
+        default:
+            throw std::runtime_error("Failed to encode unknown node type!");
+        }
+    }
+
+    BitStream& result()
+    {
+        return m_result;
+    }
+
+private:
+    void write_size(size_t size)
+    {
+        m_result << static_cast<uint32_t>(size);
+    }
+
+    void encode_children(const Node &node, size_t first)
+    {
+        for(size_t i = first; i < node.children.size(); ++i)
+            encode_next(*node.children[i]);
+    }
+
+    BitStream m_result;
+};
+
+BitStream encode_program(const Node &program)
+{
+    Encoder encoder;
+    encoder.encode_next(program);
+
+    uint8_t *data = nullptr;
+    uint32_t len = 0;
+    encoder.result().detach(data, len);
+
+    BitStream result;
+    result.assign(data, len, false);
+    return result;
+}
+
+class BindingAnalyzer
+{
+public:
+    void visit(const Node &node)
+    {
+        auto &children = node.children;
+
+        switch(node.type)
+        {
+        case NodeType::Assign:
+            for(size_t i = 1; i < children.size(); ++i)
+                bind(*children[i]);
+            break;
+        case NodeType::AugmentedAssign:
+        case NodeType::ForLoop:
+            bind(*children[0]);
+            break;
+        case NodeType::RangeLoop:
+            m_bindings.names.insert(node.name);
+            break;
+        case NodeType::ItemsLoop:
+            m_bindings.names.insert(node.name);
+            m_bindings.names.insert(node.as_name);
+            break;
+        case NodeType::Import:
+        case NodeType::ImportFrom:
+        {
+            auto &alias = *children.back();
+            auto name = alias.as_name.empty() ? alias.name : alias.as_name;
+
+            m_bindings.names.insert(name);
+            m_bindings.modules.insert(name);
+            break;
+        }
+        case NodeType::Call:
+        {
+            // Methods, e.g. list.append(), might change the object
+            auto &callee = *children[0];
+
+            if(callee.type == NodeType::Attribute)
+            {
+                auto &object = *callee.children[0];
+
+                if(object.type != NodeType::Name || !m_bindings.modules.count(object.name))
+                    m_bindings.mutates = true;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        for(auto &child: children)
+            visit(*child);
+    }
+
+    const Bindings& bindings() const
+    {
+        return m_bindings;
+    }
+
+private:
+    void bind(const Node &target)
+    {
+        if(target.type == NodeType::Name)
+            m_bindings.names.insert(target.name);
+        else if(target.type == NodeType::Subscript || target.type == NodeType::Attribute)
+            m_bindings.mutates = true;
+
+        for(auto &child: target.children)
+            bind(*child);
+    }
+
+    Bindings m_bindings;
+};
+
+Bindings analyze_bindings(const Node &program)
+{
+    BindingAnalyzer analyzer;
+    analyzer.visit(program);
+    return analyzer.bindings();
+}
+
+}
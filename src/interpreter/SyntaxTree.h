@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "json/json.h"
+#include "chipy/NodeType.h"
+
+namespace chipy
+{
+
+struct Node;
+typedef std::shared_ptr<Node> NodePtr;
+
+// Decoded form of a compiled program, used by analyses that need to look at
+// the whole program rather than executing it
+//
+// Children are stored in the order they appear in the stream, e.g. a
+// Subscript has the slice first and an Assign has the value first
+struct Node
+{
+    NodeType type;
+
+    // Range of the node in the program
+    uint32_t position = 0;
+    uint32_t end = 0;
+
+    // Name/String contents, Alias and loop variable names
+    std::string name;
+    std::string as_name;
+
+    // Also the number of slots of a ClearCache
+    int32_t integer = 0;
+
+    // Slot of a CachedValue and first slot of a ClearCache
+    uint32_t slot = 0;
+
+    // Operator of UnaryOp, BinaryOp, BoolOp and AugmentedAssign
+    uint32_t op = 0;
+
+    // Operators of a Compare, one per comparator
+    std::vector<uint32_t> ops;
+
+    // Set if the compiler emitted a BinaryOp or Compare in a specialized form,
+    // e.g. IntegerCompare. Analyses only need to handle the generic type
+    bool specialized = false;
+    NodeType specialization = NodeType::BinaryOp;
+
+    // Contents of a ConstantSet
+    std::vector<int32_t> integers;
+    std::vector<std::string> strings;
+
+    std::vector<NodePtr> children;
+};
+
+NodePtr decode_program(const BitStream &data);
+
+// Writes a (possibly modified) tree back into the format of the compiler
+// Positions are not used
+BitStream encode_program(const Node &program);
+
+struct Bindings
+{
+    // Names the program assigns anywhere, including imports and loop variables
+    std::set<std::string> names;
+    std::set<std::string> modules;
+
+    // Might the program modify a value it did not create?
+    // e.g. by assigning to a subscript or calling a method
+    bool mutates = false;
+};
+
+Bindings analyze_bindings(const Node &program);
+
+}
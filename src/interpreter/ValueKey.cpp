@@ -0,0 +1,101 @@
+#include <cstdio>
+
+#include "chipy/Dictionary.h"
+#include "chipy/List.h"
+#include "chipy/Set.h"
+#include "chipy/Tuple.h"
+#include "ValueKey.h"
+
+namespace chipy
+{
+
+bool append_value_key(const ValuePtr &value, std::string &key)
+{
+    auto append_string = [&](const std::string &str) {
+        key += std::to_string(str.size());
+        key += ':';
+        key += str;
+    };
+
+    if(!value)
+    {
+        key += 'N';
+        return true;
+    }
+
+    switch(value->type())
+    {
+    case ValueType::Bool:
+        key += value_cast<BoolVal>(value)->get() ? "b1" : "b0";
+        return true;
+    case ValueType::Integer:
+        key += 'i';
+        key += std::to_string(value_cast<IntVal>(value)->get());
+        key += ';';
+        return true;
+    case ValueType::Float:
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "f%.17g;", value_cast<FloatVal>(value)->get());
+        key += buffer;
+        return true;
+    }
+    case ValueType::String:
+        key += 's';
+        append_string(value_cast<StringVal>(value)->get());
+        return true;
+    case ValueType::List:
+    case ValueType::Set:
+    {
+        auto &elements = value->type() == ValueType::List ? value_cast<List>(value)->elements()
+                                                          : value_cast<Set>(value)->elements();
+
+        key += value->type() == ValueType::List ? 'l' : 'S';
+        key += std::to_string(elements.size());
+        key += ':';
+
+        for(auto &elem: elements)
+        {
+            if(!append_value_key(elem, key))
+                return false;
+        }
+        return true;
+    }
+    case ValueType::Tuple:
+    {
+        auto tuple = value_cast<Tuple>(value);
+
+        key += 't';
+        key += std::to_string(tuple->size());
+        key += ':';
+
+        for(uint32_t i = 0; i < tuple->size(); ++i)
+        {
+            if(!append_value_key(tuple->get(i), key))
+                return false;
+        }
+        return true;
+    }
+    case ValueType::Dictionary:
+    {
+        auto &elements = value_cast<Dictionary>(value)->elements();
+
+        key += 'd';
+        key += std::to_string(elements.size());
+        key += ':';
+
+        for(auto &it: elements)
+        {
+            append_string(it.first);
+
+            if(!append_value_key(it.second, key))
+                return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+#include "chipy/Value.h"
+
+namespace chipy
+{
+
+// Appends an encoding of value that differs for values the program could tell apart
+// Returns false for values that have none, e.g. host objects
+bool append_value_key(const ValuePtr &value, std::string &key);
+
+}
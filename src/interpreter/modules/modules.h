@@ -3,12 +3,41 @@
 namespace chipy
 {
 
+// xoshiro256** generator, see http://prng.di.unimi.it/
+class Xoshiro256
+{
+public:
+    void seed(uint64_t value);
+
+    uint64_t next();
+
+    // Uniform in [0, bound)
+    uint64_t next_below(uint64_t bound);
+
+    // Uniform in [0, 1)
+    double next_double();
+
+private:
+    uint64_t m_state[4];
+};
+
 class RandModule : public Module
 {
 public:
-    using Module::Module;
+    RandModule(MemoryManager &mem);
+
+    bool is_deterministic() const override
+    {
+        return false;
+    }
+
+    bool has_fixed_members() const override
+    {
+        return true;
+    }
 
-    ValuePtr get_member(const std::string &name)  override;
+private:
+    Xoshiro256 m_generator;
 };
 
 }
@@ -1,36 +1,129 @@
 #include "modules.h"
+#include "chipy/NativeFunction.h"
+
+#ifdef IS_ENCLAVE
+#include <sgx_trts.h>
+#else
 #include <random>
+#endif
 
 namespace chipy
 {
 
-ValuePtr RandModule::get_member(const std::string &name)
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+void Xoshiro256::seed(uint64_t value)
+{
+    // Expand the seed with splitmix64, so that similar seeds give unrelated states
+    for(auto &s: m_state)
+    {
+        value += 0x9e3779b97f4a7c15ULL;
+
+        uint64_t z = value;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        s = z ^ (z >> 31);
+    }
+}
+
+uint64_t Xoshiro256::next()
+{
+    const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+    const uint64_t t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+
+    return result;
+}
+
+uint64_t Xoshiro256::next_below(uint64_t bound)
 {
-    if(name == "randint")
+    // Reject the values that would make the modulo biased
+    const uint64_t threshold = (0 - bound) % bound;
+
+    while(true)
     {
-        auto &mem = memory_manager();
+        uint64_t r = next();
+
+        if(r >= threshold)
+            return r % bound;
+    }
+}
+
+double Xoshiro256::next_double()
+{
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+}
 
-        return wrap_value( new (mem) Function(mem,
-              [&](const std::vector<ValuePtr> &args) -> ValuePtr {
-                if(args.size() != 2)
-                    throw std::runtime_error("Invalid number of arguments");
+static uint64_t random_seed()
+{
+    uint64_t seed = 0;
 
 #ifdef IS_ENCLAVE
-                //FIXME
-                return wrap_value(new (memory_manager()) IntVal(mem, 0));
+    sgx_read_rand(reinterpret_cast<unsigned char*>(&seed), sizeof(seed));
 #else
-                auto start = value_cast<IntVal>(args[0])->get();
-                auto end = value_cast<IntVal>(args[1])->get();
-
-                std::default_random_engine generator;
-                std::uniform_int_distribution<int> distribution(start, end);
-                
-                return wrap_value(new (memory_manager()) IntVal(mem, distribution(generator)));
+    std::random_device device;
+    seed = (static_cast<uint64_t>(device()) << 32) | device();
 #endif
-            }));
-    }
-    else
-        throw std::runtime_error("No such member: " + name);
+
+    return seed;
+}
+
+RandModule::RandModule(MemoryManager &mem)
+    : Module(mem)
+{
+    m_generator.seed(random_seed());
+
+    add_member("seed", bind_function(mem, [this](int32_t value) {
+        m_generator.seed(static_cast<uint64_t>(value));
+    }));
+
+    add_member("randint", bind_function(mem, [this](int32_t start, int32_t end) -> int32_t {
+        if(end < start)
+            throw std::runtime_error("empty range for randint");
+
+        uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(end) - start) + 1;
+        return static_cast<int32_t>(start + static_cast<int64_t>(m_generator.next_below(range)));
+    }));
+
+    add_member("random", bind_function(mem, [this]() -> double {
+        return m_generator.next_double();
+    }));
+
+    add_member("shuffle", bind_function(mem, [this](ListPtr list) {
+        auto &elements = list->elements();
+
+        for(size_t i = elements.size(); i > 1; --i)
+            std::swap(elements[i-1], elements[m_generator.next_below(i)]);
+    }));
+
+    add_member("sample", bind_function(mem, [this](ListPtr population, int32_t k) -> ValuePtr {
+        auto elements = population->elements();
+
+        if(k < 0 || static_cast<size_t>(k) > elements.size())
+            throw std::runtime_error("sample larger than population");
+
+        // Partial Fisher-Yates on a copy, so only k swaps are needed
+        auto result = memory_manager().create_list();
+
+        for(int32_t i = 0; i < k; ++i)
+        {
+            auto j = i + m_generator.next_below(elements.size() - i);
+            std::swap(elements[i], elements[j]);
+            result->append(elements[i]);
+        }
+
+        return result;
+    }));
 }
 
 }
@@ -0,0 +1,110 @@
+#include "chipy/chipy.h"
+#include "chipy/ParallelEvaluator.h"
+
+#include <chrono>
+#include <cstdio>
+
+using namespace chipy;
+
+// Measures how evaluation throughput scales with the number of threads, and
+// the throughput of columnar filtering
+// Usage: chipy-benchmark [num_documents] [max_threads]
+
+static const std::string policy =
+    "if request['method'] == 'GET':\n"
+    "    return True\n"
+    "count = 0\n"
+    "for tag in request['tags']:\n"
+    "    if tag in ['admin', 'root']:\n"
+    "        count += 1\n"
+    "return count > 0 and request['user'] != 'guest'";
+
+static std::vector<json::Document> make_documents(size_t count)
+{
+    std::vector<json::Document> docs;
+    docs.reserve(count);
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        // Vary the cost per document, so static sharding would be unbalanced
+        std::string tags;
+        for(size_t j = 0; j < (i % 64); ++j)
+            tags += std::string(j > 0 ? "," : "") + (j % 17 == 16 ? "\"admin\"" : "\"user\"");
+
+        std::string method = i % 5 == 0 ? "GET" : "POST";
+        docs.emplace_back("{\"method\": \"" + method + "\", \"user\": \"user" + std::to_string(i)
+                          + "\", \"tags\": [" + tags + "]}");
+    }
+
+    return docs;
+}
+
+// A filter that the columnar evaluator runs entirely in its kernels
+static void benchmark_columnar(size_t num_rows)
+{
+    const std::vector<std::string> methods = {"GET", "POST", "PUT", "DELETE"};
+
+    std::vector<int32_t> sizes(num_rows);
+    std::vector<uint32_t> codes(num_rows);
+
+    for(size_t i = 0; i < num_rows; ++i)
+    {
+        sizes[i] = static_cast<int32_t>((i * 7919) % 10000);
+        codes[i] = i % methods.size();
+    }
+
+    ColumnBatch batch(num_rows);
+    batch.add_int_column({"request", "size"}, sizes);
+    batch.add_string_column({"request", "method"}, methods, codes);
+
+    ColumnarEvaluator evaluator(compile_code(
+        "return request['size'] < 5000 and request['method'] in ['GET', 'PUT']"));
+
+    auto start = std::chrono::steady_clock::now();
+    auto selected = evaluator.select(batch);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    printf("columnar: %zu of %zu rows selected, %.0f rows/s\n", selected.size(), num_rows,
+           num_rows / elapsed.count());
+}
+
+int main(int argc, char *argv[])
+{
+    size_t num_docs = argc > 1 ? std::stoul(argv[1]) : 200000;
+    uint32_t max_threads = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+
+    if(max_threads == 0)
+        max_threads = 1;
+
+    auto program = compile_code(policy);
+    auto docs = make_documents(num_docs);
+
+    double base = 0;
+
+    printf("threads  docs/s        speedup\n");
+
+    for(uint32_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        ParallelEvaluator evaluator(program, "request", threads);
+
+        // Warm up every worker once
+        evaluator.evaluate(docs.data(), std::min<size_t>(docs.size(), threads * 64));
+
+        auto start = std::chrono::steady_clock::now();
+        auto results = evaluator.evaluate(docs);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double rate = docs.size() / elapsed.count();
+        if(threads == 1)
+            base = rate;
+
+        printf("%7u  %12.0f  %7.2fx\n", threads, rate, rate / base);
+
+        if(threads < max_threads && threads * 2 > max_threads)
+            threads = max_threads / 2;
+    }
+
+    benchmark_columnar(num_docs * 50);
+
+    return 0;
+}
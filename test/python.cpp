@@ -1,5 +1,9 @@
 #include "chipy/chipy.h"
+#include "chipy/ParallelEvaluator.h"
+#include "chipy/DecisionCache.h"
+#include "chipy/FunctionCache.h"
 #include <gtest/gtest.h>
+#include <clocale>
 
 using namespace chipy;
 
@@ -416,3 +420,1556 @@ TEST(PythonTest, pre_set_value)
 
     EXPECT_EQ(interpreter.execute(), false);
 }
+
+TEST(PythonTest, set_literal)
+{
+    const std::string code =
+            "methods = {'GET', 'HEAD', 1}\n"
+            "return 'HEAD' in methods and 1 in methods and 'POST' not in methods";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, make_set)
+{
+    const std::string code =
+            "s = set(['a', 'b', 'a'])\n"
+            "res = 0\n"
+            "for e in s:\n"
+            "    res += 1\n"
+            "return res == 2 and 'b' in s";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, set_tables)
+{
+    MemoryManager mem;
+    auto set = mem.create_set();
+
+    // Enough elements for the tables to grow several times
+    for(int32_t i = 0; i < 1000; ++i)
+    {
+        EXPECT_TRUE(set->insert(mem.create_integer(i * 7)));
+        EXPECT_TRUE(set->insert(mem.create_string("key" + std::to_string(i))));
+    }
+
+    EXPECT_FALSE(set->insert(mem.create_integer(21)));
+    EXPECT_FALSE(set->insert(mem.create_string("key3")));
+
+    // The value that marks unused slots is stored like any other
+    EXPECT_FALSE(set->contains(std::numeric_limits<int32_t>::min()));
+    EXPECT_TRUE(set->insert(mem.create_integer(std::numeric_limits<int32_t>::min())));
+    EXPECT_FALSE(set->insert(mem.create_integer(std::numeric_limits<int32_t>::min())));
+
+    EXPECT_EQ(set->size(), 2001);
+
+    for(int32_t i = 0; i < 7000; ++i)
+    {
+        EXPECT_EQ(set->contains(i), i % 7 == 0);
+        EXPECT_EQ(set->contains("key" + std::to_string(i)), i < 1000);
+    }
+
+    EXPECT_TRUE(set->contains(std::numeric_limits<int32_t>::min()));
+    EXPECT_FALSE(set->contains(std::string("")));
+}
+
+TEST(PythonTest, pre_set_set)
+{
+    const std::string code =
+            "return user not in blocked";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+    pyint.set_set("blocked", {"mallory", "eve"});
+    pyint.set_string("user", "alice");
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, constant_in_list)
+{
+    const std::string code =
+            "hits = 0\n"
+            "for m in ['GET', 'PUT', 'TRACE', 'HEAD']:\n"
+            "    if m in ['GET', 'HEAD', 'OPTIONS', 'GET'] and 3 not in [1, 2]:\n"
+            "        hits += 1\n"
+            "return hits == 2";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, unpack_triples)
+{
+    const std::string code =
+            "rows = [(1, 'a', 2), (3, 'b', 4)]\n"
+            "res = 0\n"
+            "for x, name, y in rows:\n"
+            "    if name == 'b':\n"
+            "        res = x + y\n"
+            "a, b, c, d = [1, 2, 3, 4]\n"
+            "t = (a, b, c)\n"
+            "return res == 7 and d == 4 and t[2] == 3";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, loop_continue_next_iteration)
+{
+    const std::string code =
+           "res = 0\n"
+           "for i in [1, 2, 3]:\n"
+           "    if i == 2:\n"
+           "        continue\n"
+           "    res += i\n"
+           "return res == 4";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+    auto res = pyint.execute();
+
+    EXPECT_EQ(res, true);
+}
+
+class CountdownIterator : public LegacyGenerator
+{
+public:
+    CountdownIterator(MemoryManager &mem, int32_t start)
+        : LegacyGenerator(mem), m_pos(start)
+    {}
+
+    ValuePtr next() override
+    {
+        if(m_pos <= 0)
+            throw stop_iteration_exception();
+
+        return memory_manager().create_integer(m_pos--);
+    }
+
+    ValuePtr duplicate() override
+    {
+        return make_value<CountdownIterator>(memory_manager(), m_pos);
+    }
+
+private:
+    int32_t m_pos;
+};
+
+TEST(PythonTest, legacy_iterator)
+{
+    MemoryManager mem;
+    IteratorPtr iter = make_value<CountdownIterator>(mem, 3);
+
+    int32_t sum = 0;
+    ValuePtr next = nullptr;
+
+    while(iter->next(next))
+        sum += value_cast<IntVal>(next)->get();
+
+    EXPECT_EQ(sum, 6);
+}
+
+TEST(PythonTest, range_arguments)
+{
+    const std::string code =
+           "res = 0\n"
+           "for i in range(2, 10, 3):\n"
+           "    res += i\n"
+           "for i in range(3, 0, -1):\n"
+           "    res += i\n"
+           "it = 0\n"
+           "for i in range(1, 3):\n"
+           "    it += i\n"
+           "return res == 21 and it == 3";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, range_counter_not_shared)
+{
+    const std::string code =
+           "first = None\n"
+           "last = None\n"
+           "for i in range(3):\n"
+           "    if i == 0:\n"
+           "        first = i\n"
+           "    j = i\n"
+           "    j += 10\n"
+           "    last = i\n"
+           "return first == 0 and last == 2";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, range_shadowed)
+{
+    // Counted loops are only used while range is the builtin
+    const std::vector<std::string> codes = {
+           "total = 0\n"
+           "for i in range(3):\n"
+           "    total += i\n"
+           "return total == 30",
+           "range = pick\n"
+           "total = 0\n"
+           "for i in range(3):\n"
+           "    total += i\n"
+           "return total == 30"
+    };
+
+    for(auto &code: codes)
+    {
+        Interpreter pyint(compile_code(code));
+        auto &mem = pyint.memory_manager();
+
+        auto pick = make_value<Function>(mem, [&mem](const std::vector<ValuePtr> &args) -> ValuePtr {
+            auto list = mem.create_list();
+            list->append(mem.create_integer(10));
+            list->append(mem.create_integer(20));
+            return list;
+        });
+
+        pyint.set_value(code[0] == 'r' ? "pick" : "range", pick);
+        EXPECT_TRUE(pyint.execute());
+    }
+}
+
+TEST(PythonTest, return_from_loop)
+{
+    const std::string code =
+           "for i in range(10):\n"
+           "    if i == 3:\n"
+           "        return True\n"
+           "return False";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, return_from_nested_loops)
+{
+    const std::vector<std::string> codes = {
+           "for x in [1, 2, 3]:\n"
+           "    for y in [4, 5]:\n"
+           "        if y == 5:\n"
+           "            return x == 1\n"
+           "return False",
+           "i = 0\n"
+           "while i < 10:\n"
+           "    i += 1\n"
+           "    if i == 3:\n"
+           "        return True\n"
+           "return False"
+    };
+
+    for(auto &code: codes)
+    {
+        Interpreter pyint(compile_code(code));
+        EXPECT_TRUE(pyint.execute());
+    }
+}
+
+TEST(PythonTest, augmented_assign_alias)
+{
+    const std::string code =
+           "a = 1\n"
+           "b = a\n"
+           "l = [a]\n"
+           "b += 1\n"
+           "a += 10\n"
+           "return a == 11 and b == 2 and l[0] == 1";
+
+    Interpreter pyint(compile_code(code));
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, while_break)
+{
+    const std::string code =
+           "i = 0\n"
+           "hits = 0\n"
+           "while True:\n"
+           "    i += 1\n"
+           "    if i == 4:\n"
+           "        break\n"
+           "    hits += 1\n"
+           "rounds = 0\n"
+           "for x in [1, 2]:\n"
+           "    while True:\n"
+           "        break\n"
+           "    rounds += 1\n"
+           "return i == 4 and hits == 3 and rounds == 2";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, iterate_items_fused)
+{
+    const std::string code =
+           "headers = {'x-user': 'bob', 'x-tenant': 'acme', 'accept': '*'}\n"
+           "count = 0\n"
+           "for k, v in headers.items():\n"
+           "    if k == 'accept':\n"
+           "        continue\n"
+           "    count += 1\n"
+           "for k, v in headers.items():\n"
+           "    if k == 'x-user':\n"
+           "        return v == 'bob' and count == 2\n"
+           "return False";
+
+    auto doc = compile_code(code);
+    Interpreter pyint(doc);
+
+    EXPECT_TRUE(pyint.execute());
+}
+
+TEST(PythonTest, dictionary_key_values_are_shared)
+{
+    MemoryManager mem;
+    auto dict = mem.create_dictionary();
+    dict->insert("a", mem.create_integer(1));
+
+    auto &entry = *dict->elements().begin();
+    auto k1 = dict->key_value(entry);
+    auto k2 = dict->key_value(entry);
+
+    EXPECT_EQ(k1, k2);
+    EXPECT_EQ(k1->get(), "a");
+}
+
+TEST(PythonTest, document_view_lookup)
+{
+    const std::string code =
+           "if request['user']['name'] != 'alice':\n"
+           "    return False\n"
+           "if request['tags'][1] != 'b':\n"
+           "    return False\n"
+           "return request['a.b'] == 5";
+
+    json::Document doc("{\"user\": {\"name\": \"alice\", \"age\": 30}, \"tags\": [\"a\", \"b\"], \"a.b\": 5}");
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+    interpreter.set_document("request", doc);
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, document_view_iterate)
+{
+    const std::string code =
+           "count = 0\n"
+           "for k, v in request['user'].items():\n"
+           "    count += 1\n"
+           "return count == 2";
+
+    json::Document doc("{\"user\": {\"name\": \"alice\", \"roles\": [\"x\"]}}");
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+    interpreter.set_document("request", doc);
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, analyze_inputs)
+{
+    const std::string code =
+           "user = request['headers']['x-user']\n"
+           "if user == 'admin':\n"
+           "    return True\n"
+           "for k, v in request['params'].items():\n"
+           "    if v == user:\n"
+           "        return False\n"
+           "return op_type == 'get' and request['headers']['accept'] != ''";
+
+    auto data = compile_code(code);
+    auto inputs = analyze_inputs(data);
+
+    std::set<InputPath> expected = {
+        {"op_type"},
+        {"request", "headers", "accept"},
+        {"request", "headers", "x-user"},
+        {"request", "params"}
+    };
+
+    EXPECT_EQ(inputs.paths(), expected);
+    EXPECT_FALSE(inputs.reads({"request", "body"}));
+}
+
+TEST(PythonTest, project_document)
+{
+    const std::string code =
+           "if request['method'] != 'GET':\n"
+           "    return False\n"
+           "return request['user']['name'] == 'alice'";
+
+    json::Document doc("{\"method\": \"GET\", \"body\": [1, 2, 3], \"user\": {\"name\": \"alice\", \"age\": 30}}");
+
+    auto data = compile_code(code);
+    auto inputs = analyze_inputs(data);
+
+    Interpreter interpreter(data);
+    MemoryManager mem;
+
+    auto request = value_cast<Dictionary>(inputs.project(mem, "request", doc));
+    EXPECT_EQ(request->size(), 2);
+    EXPECT_EQ(value_cast<Dictionary>(request->get("user"))->size(), 1);
+
+    interpreter.set_document("request", doc, inputs);
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, parse_json)
+{
+    MemoryManager mem;
+
+    auto val = mem.create_from_json(
+        "{\"name\": \"a \\\"quoted\\\" string that is longer than sixteen bytes\",\n"
+        " \"unicode\": \"\\u00e9\\ud83d\\ude00\", \"list\": [1, -2, 2.5, true, null, []],\n"
+        " \"big\": 5000000000, \"nested\": {\"empty\": {}}}");
+
+    auto dict = value_cast<Dictionary>(val);
+    EXPECT_EQ(dict->size(), 5);
+    EXPECT_EQ(value_cast<StringVal>(dict->get("name"))->get(), "a \"quoted\" string that is longer than sixteen bytes");
+    EXPECT_EQ(value_cast<StringVal>(dict->get("unicode"))->get(), "\xc3\xa9\xf0\x9f\x98\x80");
+    EXPECT_EQ(dict->get("big")->type(), ValueType::Float);
+
+    auto list = value_cast<List>(dict->get("list"));
+    EXPECT_EQ(list->size(), 6);
+    EXPECT_EQ(value_cast<IntVal>(list->get(1))->get(), -2);
+    EXPECT_EQ(list->get(4), nullptr);
+
+    EXPECT_THROW(mem.create_from_json("{\"a\": [1, 2}"), std::runtime_error);
+    EXPECT_THROW(mem.create_from_json("\"unterminated"), std::runtime_error);
+}
+
+TEST(PythonTest, parse_json_numbers)
+{
+    MemoryManager mem;
+
+    EXPECT_EQ(value_cast<IntVal>(mem.create_from_json("0"))->get(), 0);
+    EXPECT_EQ(value_cast<IntVal>(mem.create_from_json("-0"))->get(), 0);
+    EXPECT_EQ(value_cast<FloatVal>(mem.create_from_json("0.25"))->get(), 0.25);
+    EXPECT_EQ(value_cast<FloatVal>(mem.create_from_json("-1.5E+2"))->get(), -150.0);
+    EXPECT_EQ(value_cast<FloatVal>(mem.create_from_json("2e-1"))->get(), 0.2);
+
+    for(auto text: {"1.", "1.e5", "1e", "1e+", "01", "-01", "-", "-.5", ".5", "+1", "0x10"})
+        EXPECT_THROW(mem.create_from_json(text), std::runtime_error) << text;
+
+    // A host locale with a decimal comma must not change how numbers are read
+    for(auto name: {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8"})
+    {
+        if(!setlocale(LC_NUMERIC, name))
+            continue;
+
+        auto value = mem.create_from_json("[2.5]");
+        setlocale(LC_NUMERIC, "C");
+
+        EXPECT_EQ(value_cast<FloatVal>(value_cast<List>(value)->get(0))->get(), 2.5);
+        break;
+    }
+}
+
+TEST(PythonTest, set_json)
+{
+    const std::string code =
+           "return request['user']['roles'][1] == 'admin'";
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+    interpreter.set_json("request", "{\"user\": {\"roles\": [\"guest\", \"admin\"]}}");
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, value_to_json)
+{
+    MemoryManager mem;
+
+    auto dict = mem.create_dictionary();
+    auto list = mem.create_list();
+    list->append(mem.create_integer(1));
+    list->append(mem.create_boolean(false));
+    list->append(mem.create_none());
+    list->append(mem.create_float(2.0));
+    list->append(mem.create_tuple(mem.create_string("a"), mem.create_string("b")));
+    dict->insert("list", list);
+    dict->insert("quote\"d", mem.create_string("line\nbreak"));
+
+    std::string out;
+    value_to_json(dict, out);
+
+    EXPECT_EQ(out, "{\"list\":[1,false,null,2.0,[\"a\",\"b\"]],\"quote\\\"d\":\"line\\nbreak\"}");
+
+    auto parsed = value_cast<Dictionary>(mem.create_from_json(out));
+    EXPECT_EQ(value_cast<StringVal>(parsed->get("quote\"d"))->get(), "line\nbreak");
+
+    // Floats use the shortest form that reads back as the same value
+    std::string floats;
+    auto numbers = mem.create_list();
+    numbers->append(mem.create_float(0.1));
+    numbers->append(mem.create_float(0.1 + 0.2));
+    numbers->append(mem.create_float(0.7999999999999999));
+    numbers->append(mem.create_float(1e300));
+    value_to_json(numbers, floats);
+
+    EXPECT_EQ(floats, "[0.1,0.30000000000000004,0.7999999999999999,1e+300]");
+
+    // A host locale with a decimal comma must not change how numbers are written
+    for(auto name: {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8"})
+    {
+        if(!setlocale(LC_NUMERIC, name))
+            continue;
+
+        std::string out;
+        value_to_json(mem.create_float(2.5), out);
+        setlocale(LC_NUMERIC, "C");
+
+        EXPECT_EQ(out, "2.5");
+        break;
+    }
+}
+
+TEST(PythonTest, value_to_document)
+{
+    MemoryManager mem;
+
+    // Deep enough that a recursive writer would be in trouble
+    ListPtr root = mem.create_list();
+    ListPtr current = root;
+
+    for(int i = 0; i < 2000; ++i)
+    {
+        auto next = mem.create_list();
+        current->append(next);
+        current = next;
+    }
+
+    current->append(mem.create_boolean(true));
+    current->append(mem.create_float(0.5));
+
+    auto doc = value_to_document(root);
+    EXPECT_EQ(doc.get_type(), json::ObjectType::Array);
+
+    std::string out;
+    value_to_json(root, out);
+    EXPECT_EQ(out.size(), 2*2001 + std::string("true,0.5").size());
+}
+
+TEST(PythonTest, external_strings)
+{
+    const std::string code =
+           "if token != 'secret':\n"
+           "    return False\n"
+           "count = 0\n"
+           "for h in headers:\n"
+           "    count += 1\n"
+           "return count == 3 and 'accept' in headers and 'x' in shared";
+
+    std::string token = "secret";
+    std::vector<std::string> headers = {"host", "accept", "user-agent"};
+    auto shared = std::make_shared<const std::vector<std::string>>(std::vector<std::string>{"x", "y"});
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+    interpreter.set_string("token", &token);
+    interpreter.set_list("headers", &headers);
+    interpreter.set_list("shared", shared);
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, external_string_is_not_copied)
+{
+    MemoryManager mem;
+    std::string host = "value";
+
+    auto str = mem.create_string(&host);
+    EXPECT_EQ(&str->get(), &host);
+
+    auto buffer = std::make_shared<const std::string>("buffer");
+    auto shared = mem.create_string(buffer);
+    EXPECT_EQ(&shared->get(), buffer.get());
+    EXPECT_EQ(buffer.use_count(), 2);
+}
+
+static bool starts_with(const std::string &str, const std::string &prefix)
+{
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+class NativeObj : public Module
+{
+public:
+    using Module::Module;
+
+    ValuePtr get_member(const std::string &name)
+    {
+        auto &mem = memory_manager();
+
+        if(name == "starts_with")
+            return bind_function(mem, &starts_with);
+        else if(name == "scale")
+            return bind_function(mem, [](int32_t i, bool negate) -> int32_t { return negate ? -2*i : 2*i; });
+        else
+            return nullptr;
+    }
+};
+
+TEST(PythonTest, bind_function)
+{
+    const std::string code =
+           "import native\n"
+           "if native.scale(3, True) != -6:\n"
+           "    return False\n"
+           "return native.starts_with(path, '/api/')";
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+    interpreter.set_module("native", wrap_value(new (interpreter.memory_manager()) NativeObj(interpreter.memory_manager())));
+    interpreter.set_string("path", "/api/users");
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, bind_function_checks_arguments)
+{
+    MemoryManager mem;
+    auto func = value_cast<Callable>(bind_function(mem, &starts_with));
+
+    ValuePtr args[] = { mem.create_string("abc"), mem.create_integer(1) };
+
+    EXPECT_THROW(func->invoke(args, 1), std::runtime_error);
+    EXPECT_THROW(func->invoke(args, 2), std::runtime_error);
+}
+
+struct HostRequest
+{
+    std::string path;
+    int32_t port;
+    std::vector<std::string> roles;
+
+    bool has_role(const std::string &role) const
+    {
+        for(auto &r: roles)
+        {
+            if(r == role)
+                return true;
+        }
+
+        return false;
+    }
+};
+
+TEST(PythonTest, cpp_object)
+{
+    static const CppClass request_class = CppClass()
+        .add(CHIPY_FIELD(HostRequest, path))
+        .add(CHIPY_FIELD(HostRequest, port))
+        .add(CHIPY_FIELD(HostRequest, roles))
+        .add(CHIPY_METHOD(HostRequest, has_role));
+
+    const std::string code =
+           "if request.port != 443 or 'admin' not in request.roles:\n"
+           "    return False\n"
+           "return request.path == '/admin' and request.has_role('admin')";
+
+    HostRequest request;
+    request.path = "/admin";
+    request.port = 443;
+    request.roles = {"user", "admin"};
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+    interpreter.set_value("request", make_cpp_object(interpreter.memory_manager(), request_class, &request));
+
+    EXPECT_TRUE(interpreter.execute());
+
+    auto obj = value_cast<CppObject>(make_cpp_object(interpreter.memory_manager(), request_class, &request));
+    EXPECT_EQ(&value_cast<StringVal>(obj->get_member("path"))->get(), &request.path);
+    EXPECT_THROW(obj->get_member("secret"), std::runtime_error);
+}
+
+class CountingObj : public Module
+{
+public:
+    CountingObj(MemoryManager &mem, int &lookups, bool fixed)
+        : Module(mem), m_lookups(lookups), m_fixed(fixed)
+    {}
+
+    ValuePtr get_member(const std::string &name)
+    {
+        m_lookups += 1;
+        return bind_function(memory_manager(), [](int32_t i) -> int32_t { return i + 1; });
+    }
+
+    bool has_fixed_members() const override
+    {
+        return m_fixed;
+    }
+
+private:
+    int &m_lookups;
+    bool m_fixed;
+};
+
+TEST(PythonTest, attribute_cache)
+{
+    const std::string code =
+           "import counter\n"
+           "import rand\n"
+           "total = 0\n"
+           "for i in range(10):\n"
+           "    total += counter.inc(i)\n"
+           "    r = rand.randint(1, 6)\n"
+           "    if r < 1 or r > 6:\n"
+           "        return False\n"
+           "return total == 55";
+
+    auto data = compile_code(code);
+
+    for(bool fixed: {true, false})
+    {
+        int lookups = 0;
+
+        Interpreter interpreter(data);
+        interpreter.set_module("counter", wrap_value(new (interpreter.memory_manager()) CountingObj(interpreter.memory_manager(), lookups, fixed)));
+        interpreter.prepare();
+
+        EXPECT_TRUE(interpreter.execute());
+
+        // Other modules may compute a different member every time
+        EXPECT_EQ(lookups, fixed ? 1 : 10);
+    }
+}
+
+TEST(PythonTest, rand_module)
+{
+    const std::string code =
+           "import rand\n"
+           "rand.seed(7)\n"
+           "first = rand.randint(0, 1000000)\n"
+           "differs = False\n"
+           "for i in range(10):\n"
+           "    if rand.randint(0, 1000000) != first:\n"
+           "        differs = True\n"
+           "r = rand.random()\n"
+           "rand.seed(7)\n"
+           "return differs and rand.randint(0, 1000000) == first";
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, rand_sample_shuffle)
+{
+    const std::string code =
+           "import rand\n"
+           "l = [1, 2, 3, 4, 5]\n"
+           "rand.shuffle(l)\n"
+           "total = 0\n"
+           "for x in l:\n"
+           "    total += x\n"
+           "s = rand.sample(l, 2)\n"
+           "return total == 15 and s[0] != s[1] and s[0] in l";
+
+    auto data = compile_code(code);
+    Interpreter interpreter(data);
+
+    EXPECT_TRUE(interpreter.execute());
+}
+
+TEST(PythonTest, numeric_comparisons)
+{
+    const std::string code =
+           "y = 2\n"
+           "if x != 1 or not x == 1 or x > 1 or not x >= 1 or not x < y:\n"
+           "    return False\n"
+           "if x not in [1, 2] or x not in [y, 1] or x not in set([1, 2]):\n"
+           "    return False\n"
+           "if z == 1 or z in [1, 2] or z in [y, 1] or not z > 1:\n"
+           "    return False\n"
+           "return x == x and True != 1";
+
+    auto data = compile_code(code);
+
+    Interpreter interpreter(data);
+    interpreter.set_value("x", interpreter.memory_manager().create_float(1.0));
+    interpreter.set_value("z", interpreter.memory_manager().create_float(1.5));
+
+    EXPECT_TRUE(interpreter.execute());
+
+    int32_t i = 0;
+    EXPECT_TRUE(integer_value(-3.0, i));
+    EXPECT_EQ(i, -3);
+    EXPECT_FALSE(integer_value(0.5, i));
+    EXPECT_FALSE(integer_value(1e10, i));
+    EXPECT_FALSE(integer_value(std::numeric_limits<double>::quiet_NaN(), i));
+
+    // Guards on integers also match equal floats
+    PolicyIndex index({compile_code("return request['n'] == 3 and request['ok']")}, "request");
+
+    json::Document match("{\"n\": 3.0, \"ok\": true}");
+    json::Document other("{\"n\": 3.5, \"ok\": true}");
+    EXPECT_EQ(index.candidates(match), std::vector<size_t>({0}));
+    EXPECT_EQ(index.candidates(other), std::vector<size_t>());
+    EXPECT_EQ(index.evaluate(match), std::vector<bool>({true}));
+}
+
+TEST(PythonTest, memory_manager_reuse)
+{
+    MemoryManager mem;
+
+    auto mark = mem.mark();
+    auto first = mem.create_string("first");
+    auto addr = first.get();
+    first.reset();
+
+    EXPECT_TRUE(mem.release(mark));
+    EXPECT_EQ(mem.create_integer(1).get(), static_cast<void*>(addr));
+
+    auto kept = mem.create_integer(2);
+    EXPECT_FALSE(mem.release(mark));
+    kept.reset();
+
+    // Released regions are reused, so the arena does not grow
+    for(int i = 0; i < 10; ++i)
+    {
+        auto values = mem.create_list();
+        for(int j = 0; j < 1000; ++j)
+            values->append(mem.create_integer(j));
+        values.reset();
+
+        EXPECT_TRUE(mem.release(mark));
+        EXPECT_EQ(mem.mark(), mark);
+    }
+
+    // Allocations larger than a page get a page of their own
+    auto big = mem.create_tuple(MemoryManager::PAGE_SIZE / sizeof(ValuePtr));
+    EXPECT_EQ(big->size(), MemoryManager::PAGE_SIZE / sizeof(ValuePtr));
+}
+
+TEST(PythonTest, batch_evaluator)
+{
+    const std::string code =
+           "if request['method'] == 'GET':\n"
+           "    return True\n"
+           "return request['user'] in ['admin', 'root']";
+
+    std::vector<json::Document> docs;
+    docs.emplace_back("{\"method\": \"GET\", \"user\": \"bob\"}");
+    docs.emplace_back("{\"method\": \"POST\", \"user\": \"bob\"}");
+    docs.emplace_back("{\"method\": \"POST\", \"user\": \"root\"}");
+
+    BatchEvaluator evaluator(compile_code(code), "request");
+    auto &mem = evaluator.interpreter().memory_manager();
+
+    std::vector<bool> expected = {true, false, true};
+    EXPECT_EQ(evaluator.evaluate(docs), expected);
+
+    // Every record is released, so the arena starts over at the same page
+    auto mark = mem.mark();
+
+    for(int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(evaluator.evaluate(docs), expected);
+        EXPECT_EQ(mem.mark(), mark);
+        EXPECT_TRUE(mem.release(mark));
+    }
+
+    // Values set between records are kept, and later records are still released
+    evaluator.interpreter().set_module("foo", wrap_value(new (mem) FooObj(mem)));
+    EXPECT_EQ(evaluator.evaluate(docs), expected);
+
+    mark = mem.mark();
+    EXPECT_EQ(evaluator.evaluate(docs), expected);
+    EXPECT_EQ(mem.mark(), mark);
+}
+
+class KeepObj : public Module
+{
+public:
+    using Module::Module;
+
+    ValuePtr get_member(const std::string &name)
+    {
+        return make_value<Function>(memory_manager(),
+              [this](const std::vector<ValuePtr> &args) -> ValuePtr {
+                  if(keeping)
+                      kept = args[0];
+                  return nullptr;
+        });
+    }
+
+    bool keeping = true;
+    ValuePtr kept;
+};
+
+TEST(PythonTest, batch_evaluator_leaked_record)
+{
+    const std::string code =
+           "import keep\n"
+           "keep.value(request['user'])\n"
+           "return True";
+
+    BatchEvaluator evaluator(compile_code(code), "request");
+    auto &mem = evaluator.interpreter().memory_manager();
+
+    auto module = new (mem) KeepObj(mem);
+    evaluator.interpreter().set_module("keep", wrap_value(module));
+
+    json::Document doc("{\"user\": \"bob\"}");
+
+    // The record's memory could never be reused
+    EXPECT_THROW(evaluator.evaluate(doc), std::runtime_error);
+
+    module->keeping = false;
+    module->kept.reset();
+    EXPECT_TRUE(evaluator.evaluate(doc));
+}
+
+TEST(PythonTest, batch_evaluator_specialized_compare)
+{
+    BatchEvaluator evaluator(compile_code("return request['n'] > 5"), "request");
+    auto &mem = evaluator.interpreter().memory_manager();
+
+    json::Document small("{\"n\": 3}");
+    json::Document large("{\"n\": 7}");
+
+    EXPECT_TRUE(evaluator.evaluate(large));
+
+    // Every record is released, so the arena starts over at the same page
+    auto mark = mem.mark();
+
+    for(int i = 0; i < 10; ++i)
+    {
+        EXPECT_FALSE(evaluator.evaluate(small));
+        EXPECT_TRUE(evaluator.evaluate(large));
+        EXPECT_EQ(mem.mark(), mark);
+        EXPECT_TRUE(mem.release(mark));
+    }
+}
+
+TEST(PythonTest, parallel_evaluator)
+{
+    const std::string code =
+           "import rand\n"
+           "total = 0\n"
+           "for i in range(request['n']):\n"
+           "    total += i\n"
+           "return total == request['expected'] and rand.randint(1, 1) == 1";
+
+    std::vector<json::Document> docs;
+    std::vector<bool> expected;
+
+    for(int i = 0; i < 500; ++i)
+    {
+        int n = i % 50;
+        int sum = n * (n - 1) / 2;
+        bool correct = i % 3 != 0;
+
+        docs.emplace_back("{\"n\": " + std::to_string(n) + ", \"expected\": " + std::to_string(correct ? sum : sum + 1) + "}");
+        expected.push_back(correct);
+    }
+
+    ParallelEvaluator evaluator(compile_code(code), "request", 4);
+    EXPECT_EQ(evaluator.num_threads(), 4);
+
+    for(int i = 0; i < 3; ++i)
+        EXPECT_EQ(evaluator.evaluate(docs), expected);
+
+    // Values set up between evaluations are kept apart from the records
+    evaluator.setup([](Interpreter &interpreter) {
+        auto &mem = interpreter.memory_manager();
+        interpreter.set_module("foo", wrap_value(new (mem) FooObj(mem)));
+    });
+
+    EXPECT_EQ(evaluator.evaluate(docs), expected);
+
+    docs.emplace_back("{\"n\": \"not a number\"}");
+    EXPECT_THROW(evaluator.evaluate(docs), std::runtime_error);
+}
+
+TEST(PythonTest, columnar_evaluator)
+{
+    const size_t num_rows = 1000;
+    const std::vector<std::string> users = {"alice", "bob", "eve", "mallory"};
+
+    std::vector<int32_t> ages;
+    std::vector<double> scores;
+    std::vector<uint32_t> codes;
+
+    for(size_t i = 0; i < num_rows; ++i)
+    {
+        ages.push_back(static_cast<int32_t>(i % 97));
+        scores.push_back((i % 13) * 0.5);
+        codes.push_back(i % users.size());
+    }
+
+    ColumnBatch batch(num_rows);
+    batch.add_int_column({"request", "age"}, ages);
+    batch.add_float_column({"request", "score"}, scores);
+    batch.add_string_column({"request", "user"}, users, codes);
+
+    const std::string code =
+           "return (request['age'] >= 18 and 4 > request['score'] and not request['user'] in ['eve', 'mallory'])"
+           " or request['user'] == 'mallory' or request['age'] in {1, 2, 3}";
+
+    ColumnarEvaluator evaluator(compile_code(code));
+    EXPECT_TRUE(evaluator.is_vectorized(batch));
+
+    auto results = evaluator.evaluate(batch);
+    ASSERT_EQ(results.size(), num_rows);
+
+    for(size_t i = 0; i < num_rows; ++i)
+    {
+        auto &user = users[codes[i]];
+        bool expected = (ages[i] >= 18 && scores[i] < 4 && user != "eve" && user != "mallory")
+                        || user == "mallory" || (ages[i] >= 1 && ages[i] <= 3);
+
+        EXPECT_EQ(results[i], expected);
+    }
+
+    EXPECT_EQ(evaluator.num_scalar_rows(), 0);
+}
+
+TEST(PythonTest, columnar_evaluator_fallback)
+{
+    ColumnBatch batch(100);
+
+    std::vector<int32_t> ages;
+    for(int32_t i = 0; i < 100; ++i)
+        ages.push_back(i);
+
+    batch.add_int_column({"request", "age"}, ages);
+
+    const std::string code =
+           "return request['age'] > 40 and str(request['age']) in ['42', '99', '7']";
+
+    ColumnarEvaluator evaluator(compile_code(code));
+    EXPECT_FALSE(evaluator.is_vectorized(batch));
+
+    auto selected = evaluator.select(batch);
+    EXPECT_EQ(selected, std::vector<uint32_t>({42, 99}));
+
+    // Only the rows that passed the vectorized prefix were interpreted
+    EXPECT_EQ(evaluator.num_scalar_rows(), 59);
+
+    // Strings cannot be ordered, so this is left to the interpreter
+    ColumnBatch strings(2);
+    strings.add_string_column({"name"}, {"a", "b"}, {0, 1});
+
+    ColumnarEvaluator compare(compile_code("return name == 'b' or name > 'a'"));
+    EXPECT_FALSE(compare.is_vectorized(strings));
+    EXPECT_EQ(compare.evaluate(strings), std::vector<bool>({false, true}));
+    EXPECT_EQ(compare.num_scalar_rows(), 1);
+}
+
+TEST(PythonTest, policy_set)
+{
+    const std::vector<std::string> codes = {
+        "return request['method'] == 'GET' and request['user'] in ['alice', 'bob']",
+        "return request['method'] == 'GET' and request['path'] == '/admin'",
+        "if request['method'] == 'GET':\n"
+        "    return True\n"
+        "return request['size'] > 100",
+        // Rebinds its input, so it gets a copy of its own
+        "if request['user'] == 'eve':\n"
+        "    request = {'user': 'alice'}\n"
+        "return request['user'] in ['alice', 'bob']",
+        "return request['user'] in ['alice', 'bob'] and request['size'] > 100"
+    };
+
+    std::vector<BitStream> programs;
+    for(auto &code: codes)
+        programs.push_back(compile_code(code));
+
+    PolicySet policies(programs, "request");
+    EXPECT_EQ(policies.size(), codes.size());
+
+    // request['method'] == 'GET', the `in` test and the size compare
+    EXPECT_EQ(policies.num_shared_expressions(), 3);
+
+    const std::vector<std::string> requests = {
+        "{\"method\": \"GET\", \"user\": \"alice\", \"path\": \"/admin\", \"size\": 10}",
+        "{\"method\": \"POST\", \"user\": \"bob\", \"path\": \"/\", \"size\": 1000}",
+        "{\"method\": \"GET\", \"user\": \"eve\", \"path\": \"/\", \"size\": 1000}"
+    };
+
+    for(int round = 0; round < 2; ++round)
+    {
+        for(auto &request: requests)
+        {
+            json::Document doc(request);
+            std::vector<bool> expected;
+
+            for(auto &program: programs)
+            {
+                BatchEvaluator evaluator(program, "request");
+                expected.push_back(evaluator.evaluate(doc));
+            }
+
+            EXPECT_EQ(policies.evaluate(doc), expected);
+        }
+    }
+}
+
+TEST(PythonTest, policy_index)
+{
+    const std::vector<std::string> codes = {
+        "if request['op'] == 'put' and request['table'] == 'users':\n"
+        "    return request['user'] == 'admin'\n"
+        "return False",
+        "if request['op'] == 'get':\n"
+        "    return True\n"
+        "return False",
+        "return request['table'] == 'orders' and request['op'] == 'put' and request['user'] == 'bob'",
+        "if request['op'] == 'delete':\n"
+        "    return False\n"
+        "else:\n"
+        "    return True",
+        // No guards, so this always runs
+        "return request['user'] == 'admin' or request['op'] == 'get'"
+    };
+
+    std::vector<BitStream> programs;
+    for(auto &code: codes)
+        programs.push_back(compile_code(code));
+
+    auto guards = analyze_guards(programs[0], "request");
+    ASSERT_EQ(guards.guards.size(), 2);
+    EXPECT_EQ(guards.guards[1].path, InputPath({"request", "table"}));
+    EXPECT_EQ(guards.guards[1].string_value, "users");
+    EXPECT_FALSE(guards.default_result);
+    EXPECT_TRUE(analyze_guards(programs[3], "request").default_result);
+
+    PolicyIndex index(programs, "request");
+    EXPECT_EQ(index.num_unindexed(), 1);
+
+    PolicySet all(programs, "request");
+
+    json::Document put("{\"op\": \"put\", \"table\": \"users\", \"user\": \"admin\"}");
+    EXPECT_EQ(index.candidates(put), std::vector<size_t>({0, 4}));
+    EXPECT_EQ(index.evaluate(put), all.evaluate(put));
+
+    // Without a table, programs guarded on it have to run to keep their behavior
+    json::Document get("{\"op\": \"get\", \"user\": \"bob\"}");
+    EXPECT_EQ(index.candidates(get), std::vector<size_t>({0, 1, 2, 4}));
+    EXPECT_EQ(index.evaluate(get), all.evaluate(get));
+
+    json::Document del("{\"op\": \"delete\", \"table\": \"orders\", \"user\": \"bob\"}");
+    EXPECT_EQ(index.candidates(del), std::vector<size_t>({3, 4}));
+    EXPECT_EQ(index.evaluate(del), all.evaluate(del));
+}
+
+TEST(PythonTest, decision_cache)
+{
+    const std::string code =
+           "if request['method'] == 'GET':\n"
+           "    return True\n"
+           "return request['user']['name'] in ['alice', 'bob']";
+
+    Interpreter interpreter(compile_code(code));
+    DecisionCache cache;
+
+    auto run = [&](const std::string &json) {
+        json::Document doc(json);
+        interpreter.set_document("request", doc);
+        auto result = cache.execute(interpreter);
+        interpreter.reset();
+        return result;
+    };
+
+    EXPECT_TRUE(run("{\"method\": \"GET\", \"user\": {\"name\": \"eve\"}}"));
+    // Only the method was read, so the user does not matter
+    EXPECT_TRUE(run("{\"method\": \"GET\", \"user\": {\"name\": \"mallory\"}, \"size\": 5}"));
+    EXPECT_EQ(cache.hits(), 1);
+
+    EXPECT_FALSE(run("{\"method\": \"POST\", \"user\": {\"name\": \"eve\", \"id\": 1}}"));
+    EXPECT_FALSE(run("{\"method\": \"POST\", \"user\": {\"name\": \"eve\", \"id\": 2}}"));
+    EXPECT_TRUE(run("{\"method\": \"POST\", \"user\": {\"name\": \"bob\"}}"));
+    EXPECT_EQ(cache.hits(), 2);
+    EXPECT_EQ(cache.misses(), 3);
+    EXPECT_EQ(cache.size(), 3);
+    EXPECT_TRUE(cache.is_cacheable());
+
+    // Bounded, least recently used entries go first
+    DecisionCache small(2, 1);
+    Interpreter counter(compile_code("return value > 10"));
+
+    for(int i = 0; i < 5; ++i)
+    {
+        counter.set_value("value", counter.memory_manager().create_integer(i));
+        small.execute(counter);
+        counter.reset();
+    }
+
+    EXPECT_EQ(small.size(), 2);
+    EXPECT_EQ(small.misses(), 5);
+
+    // Never cached, as results would differ between runs
+    Interpreter random(compile_code("import rand\nreturn rand.randint(0, 1) == 1 and x == 1"));
+    DecisionCache uncacheable;
+
+    for(int i = 0; i < 3; ++i)
+    {
+        random.set_value("x", random.memory_manager().create_integer(1));
+        uncacheable.execute(random);
+        random.reset();
+    }
+
+    EXPECT_FALSE(uncacheable.is_cacheable());
+    EXPECT_EQ(uncacheable.hits(), 0);
+    EXPECT_EQ(uncacheable.size(), 0);
+}
+
+TEST(PythonTest, function_cache)
+{
+    const std::string code =
+           "if 'admin' in groups(user):\n"
+           "    return True\n"
+           "return 'dev' in groups(user) and 'dev' in groups(user)";
+
+    int lookups = 0;
+    FunctionCache cache;
+
+    auto run = [&](const std::string &user) {
+        Interpreter interpreter(compile_code(code));
+        auto &mem = interpreter.memory_manager();
+
+        auto groups = make_value<Function>(mem, [&](const std::vector<ValuePtr> &args) -> ValuePtr {
+            lookups += 1;
+
+            auto result = mem.create_list();
+            result->append(mem.create_string(value_cast<StringVal>(args[0])->get() == "alice" ? "dev" : "ops"));
+            return result;
+        });
+
+        interpreter.set_value("groups", cache.make_pure(mem, "groups", groups));
+        interpreter.set_string("user", user);
+
+        EXPECT_THROW(cache.make_pure(mem, "groups", mem.create_integer(1)), std::runtime_error);
+        return interpreter.execute();
+    };
+
+    EXPECT_TRUE(run("alice"));
+
+    // Lists are rebuilt for every call, so only the first call runs the function
+    EXPECT_EQ(lookups, 1);
+    EXPECT_EQ(cache.stats("groups").calls, 3);
+    EXPECT_EQ(cache.stats("groups").shared_hits, 2);
+
+    EXPECT_TRUE(run("alice"));
+    EXPECT_FALSE(run("bob"));
+
+    EXPECT_EQ(lookups, 2);
+    EXPECT_EQ(cache.size(), 2);
+    EXPECT_EQ(cache.stats("groups").calls, 8);
+    EXPECT_NEAR(cache.stats("groups").hit_rate(), 6.0 / 8.0, 1e-9);
+}
+
+TEST(PythonTest, function_cache_reuses_results_within_execution)
+{
+    const std::string code =
+           "total = 0\n"
+           "for i in range(10):\n"
+           "    total += square(3)\n"
+           "return total == 90";
+
+    int calls = 0;
+    FunctionCache cache(10);
+
+    Interpreter interpreter(compile_code(code));
+    auto square = bind_function(interpreter.memory_manager(), [&](int32_t i) -> int32_t { calls += 1; return i * i; });
+    interpreter.set_value("square", cache.make_pure(interpreter.memory_manager(), "square", square, std::chrono::milliseconds(1)));
+
+    EXPECT_TRUE(interpreter.execute());
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(cache.stats("square").execution_hits, 9);
+    interpreter.reset();
+
+    // Expired results are computed again
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    interpreter.set_value("square", cache.make_pure(interpreter.memory_manager(), "square", square, std::chrono::milliseconds(1)));
+
+    EXPECT_TRUE(interpreter.execute());
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(cache.stats("square").shared_hits, 0);
+    EXPECT_THROW(cache.make_pure(interpreter.memory_manager(), "square", square), std::runtime_error);
+}
+
+TEST(PythonTest, partial_evaluator)
+{
+    const std::string code =
+           "if mode == 'audit':\n"
+           "    return True\n"
+           "if op in writable and request['size'] <= limits['max_size']:\n"
+           "    return request['user'] in admins\n"
+           "return False";
+
+    auto program = compile_code(code);
+
+    MemoryManager mem;
+    auto limits = mem.create_dictionary();
+    limits->insert("max_size", mem.create_integer(100));
+
+    PartialEvaluator partial(program);
+    partial.set_string("mode", "enforce");
+    partial.set_string("op", "write");
+    partial.set_set("writable", {"write", "delete"});
+    partial.set_value("limits", limits);
+    partial.set_list("admins", {"alice", "bob"});
+
+    auto residual = partial.specialize();
+    EXPECT_LT(residual.size(), program.size());
+
+    EXPECT_THROW(partial.set_value("ratio", mem.create_float(0.5)), std::runtime_error);
+
+    for(auto request : {"{\"size\": 10, \"user\": \"alice\"}", "{\"size\": 10, \"user\": \"eve\"}", "{\"size\": 500, \"user\": \"bob\"}"})
+    {
+        Interpreter original(program);
+        original.set_string("mode", "enforce");
+        original.set_string("op", "write");
+        original.set_set("writable", {"write", "delete"});
+        original.set_value("limits", limits);
+        original.set_list("admins", {"alice", "bob"});
+        original.set_json("request", request);
+
+        // Known values do not have to be bound anymore
+        Interpreter specialized(residual);
+        specialized.set_json("request", request);
+
+        EXPECT_EQ(original.execute(), specialized.execute());
+    }
+}
+
+TEST(PythonTest, partial_evaluator_keeps_rebound_names)
+{
+    const std::string code =
+           "if mode == 'a':\n"
+           "    mode = 'b'\n"
+           "return mode == 'b' and not debug";
+
+    auto program = compile_code(code);
+    MemoryManager mem;
+
+    for(auto mode : {"a", "c"})
+    {
+        PartialEvaluator partial(program);
+        partial.set_string("mode", mode);
+        partial.set_value("debug", mem.create_boolean(false));
+
+        Interpreter original(program);
+        original.set_string("mode", mode);
+        original.set_value("debug", original.memory_manager().create_boolean(false));
+
+        Interpreter specialized(partial.specialize());
+
+        EXPECT_EQ(original.execute(), specialized.execute()) << mode;
+    }
+}
+
+TEST(PythonTest, optimizer)
+{
+    const std::string code =
+           "count = 0\n"
+           "for role in roles:\n"
+           "    if request['user']['tenant'] == 'acme' and role in request['user']['roles']:\n"
+           "        count += 1\n"
+           "if request['user']['tenant'] == 'acme':\n"
+           "    return count == 2\n"
+           "if request['user']['tenant'] == 'initech':\n"
+           "    return count == 0\n"
+           "return False";
+
+    auto program = compile_code(code);
+
+    Optimizer optimizer(program);
+    auto optimized = optimizer.optimize();
+
+    EXPECT_EQ(optimizer.num_hoisted(), 2);
+    EXPECT_EQ(optimizer.num_eliminated(), 1);
+
+    auto run = [](const BitStream &data, const std::string &json) {
+        json::Document doc(json);
+        Interpreter interpreter(data);
+        interpreter.set_list("roles", {"admin", "dev", "ops"});
+        interpreter.set_document("request", doc);
+
+        return interpreter.execute();
+    };
+
+    for(auto json : {"{\"user\": {\"tenant\": \"acme\", \"roles\": [\"dev\", \"ops\"]}}",
+                     "{\"user\": {\"tenant\": \"acme\", \"roles\": [\"dev\"]}}",
+                     "{\"user\": {\"tenant\": \"initech\", \"roles\": [\"dev\"]}}"})
+    {
+        EXPECT_EQ(run(program, json), run(optimized, json)) << json;
+    }
+
+    EXPECT_TRUE(run(optimized, "{\"user\": {\"tenant\": \"acme\", \"roles\": [\"dev\", \"ops\"]}}"));
+}
+
+TEST(PythonTest, optimizer_respects_effects)
+{
+    const std::string opaque =
+           "for x in xs:\n"
+           "    if lookup(x) and request['a'] == 1:\n"
+           "        return True\n"
+           "return False";
+
+    Optimizer optimizer(compile_code(opaque));
+    optimizer.optimize();
+    EXPECT_EQ(optimizer.num_hoisted(), 0);
+
+    // lookup(x) still depends on the loop
+    optimizer.add_pure_function("lookup");
+    optimizer.optimize();
+    EXPECT_EQ(optimizer.num_hoisted(), 1);
+
+    const std::string mutating =
+           "out = []\n"
+           "for x in xs:\n"
+           "    out.append(request['a'])\n"
+           "return out";
+
+    Optimizer other(compile_code(mutating));
+    other.optimize();
+    EXPECT_EQ(other.num_hoisted(), 0);
+}
+
+TEST(PythonTest, specialized_operations)
+{
+    const std::string code =
+           "total = 0\n"
+           "for i in range(10):\n"
+           "    total = total + i * 2\n"
+           "if level > 3 and name == 'admin':\n"
+           "    return total == 90\n"
+           "return False";
+
+    auto program = compile_code(code);
+
+    auto run = [&](const ValuePtr &level, const ValuePtr &name) {
+        Interpreter interpreter(program);
+        interpreter.set_value("level", level);
+        interpreter.set_value("name", name);
+        return interpreter.execute();
+    };
+
+    MemoryManager mem;
+    auto admin = mem.create_string("admin");
+
+    EXPECT_TRUE(run(mem.create_integer(5), admin));
+    EXPECT_FALSE(run(mem.create_integer(3), admin));
+
+    // Operands of other types fall back to the generic operations
+    EXPECT_TRUE(run(mem.create_float(3.5), admin));
+    EXPECT_FALSE(run(mem.create_integer(5), mem.create_integer(1)));
+}
+
+TEST(PythonTest, nested_scope_lookup)
+{
+    const std::string code =
+           "total = 0\n"
+           "for i in range(3):\n"
+           "    for j in range(2):\n"
+           "        total += int(str(limit))\n"
+           "return total == 30";
+
+    Interpreter interpreter(compile_code(code));
+    interpreter.set_value("limit", interpreter.memory_manager().create_integer(5));
+    EXPECT_TRUE(interpreter.execute());
+}
+
+class PairsObj : public Module
+{
+public:
+    using Module::Module;
+
+    ValuePtr get_member(const std::string &name)
+    {
+        auto &mem = memory_manager();
+
+        return make_value<Function>(mem,
+              [&](const std::vector<ValuePtr> &args) -> ValuePtr {
+                  auto list = mem.create_list();
+
+                  for(int32_t i = 1; i <= 2; ++i)
+                  {
+                      auto pair = mem.create_tuple(2);
+                      pair->set(0, mem.create_string("key" + std::to_string(i)));
+                      pair->set(1, mem.create_integer(i));
+                      list->append(pair);
+                  }
+
+                  return list;
+        });
+    }
+};
+
+TEST(PythonTest, items_loop_on_other_receivers)
+{
+    const std::string code =
+           "import pairs\n"
+           "total = 0\n"
+           "for k, v in pairs.items():\n"
+           "    total += v\n"
+           "return total == 3";
+
+    Interpreter interpreter(compile_code(code));
+    auto &mem = interpreter.memory_manager();
+    interpreter.set_module("pairs", wrap_value(new (mem) PairsObj(mem)));
+    EXPECT_TRUE(interpreter.execute());
+
+    Interpreter list(compile_code("for k, v in values.items():\n    return True\nreturn False"));
+    list.set_list("values", {"a"});
+
+    try
+    {
+        list.execute();
+        FAIL() << "expected an error";
+    }
+    catch(const std::runtime_error &e)
+    {
+        EXPECT_EQ(std::string(e.what()), "Cannot get attribute");
+    }
+}
+
+TEST(PythonTest, append_to_lazy_list)
+{
+    MemoryManager mem;
+    json::Document doc("[\"alice\", \"bob\"]");
+
+    // Elements of the document are only loaded on first access
+    auto list = value_cast<List>(mem.create_document_view(doc));
+    list->append(mem.create_string("carol"));
+
+    ASSERT_EQ(list->size(), 3);
+    EXPECT_EQ(value_cast<StringVal>(list->get(0))->get(), "alice");
+    EXPECT_EQ(value_cast<StringVal>(list->get(2))->get(), "carol");
+}